@@ -491,6 +491,11 @@ cSetup::cSetup(void)
   ChannelsWrap = 0;
   ShowChannelNamesWithSource = 0;
   EmergencyExit = 1;
+  TsBufferSize = 5;
+  RecorderBufferSize = 20;
+  PlayerBufferSize = 1;
+  UseHugePages = 0;
+  MaxCopyRate = 0;
 }
 
 cSetup& cSetup::operator= (const cSetup &s)
@@ -713,6 +718,11 @@ bool cSetup::Parse(const char *Name, const char *Value)
   else if (!strcasecmp(Name, "ChannelsWrap"))        ChannelsWrap       = atoi(Value);
   else if (!strcasecmp(Name, "ShowChannelNamesWithSource")) ShowChannelNamesWithSource = atoi(Value);
   else if (!strcasecmp(Name, "EmergencyExit"))       EmergencyExit      = atoi(Value);
+  else if (!strcasecmp(Name, "TsBufferSize"))        TsBufferSize       = atoi(Value);
+  else if (!strcasecmp(Name, "RecorderBufferSize"))  RecorderBufferSize = atoi(Value);
+  else if (!strcasecmp(Name, "PlayerBufferSize"))    PlayerBufferSize   = atoi(Value);
+  else if (!strcasecmp(Name, "UseHugePages"))        UseHugePages       = atoi(Value);
+  else if (!strcasecmp(Name, "MaxCopyRate"))         MaxCopyRate        = atoi(Value);
   else if (!strcasecmp(Name, "LastReplayed"))        cReplayControl::SetRecording(Value);
   else
      return false;
@@ -839,6 +849,11 @@ bool cSetup::Save(void)
   Store("ChannelsWrap",       ChannelsWrap);
   Store("ShowChannelNamesWithSource", ShowChannelNamesWithSource);
   Store("EmergencyExit",      EmergencyExit);
+  Store("TsBufferSize",       TsBufferSize);
+  Store("RecorderBufferSize", RecorderBufferSize);
+  Store("PlayerBufferSize",   PlayerBufferSize);
+  Store("UseHugePages",       UseHugePages);
+  Store("MaxCopyRate",        MaxCopyRate);
   Store("LastReplayed",       cReplayControl::LastReplayed());
 
   Sort();
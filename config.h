@@ -22,14 +22,19 @@
 
 // VDR's own version number:
 
-#define VDRVERSION  "2.2.0"
+#define VDRVERSION  "2.2.0-ext1"
 #define VDRVERSNUM   20200  // Version * 10000 + Major * 100 + Minor
 
 // The plugin API's version number:
 
-#define APIVERSION  "2.2.0"
+#define APIVERSION  "2.2.0-ext1"
 #define APIVERSNUM   20200  // Version * 10000 + Major * 100 + Minor
 
+// This is an extended version of VDR 2.2.0, with changes to several header
+// files. The version numbers stay at 2.2.0, so that plugins don't expect
+// the API of later official versions, but the suffix of APIVERSION makes
+// sure plugins that were compiled for the official 2.2.0 aren't loaded.
+
 // When loading plugins, VDR searches them by their APIVERSION, which
 // may be smaller than VDRVERSION in case there have been no changes to
 // VDR header files since the last APIVERSION. This allows compiled
@@ -353,6 +358,11 @@ public:
   int ChannelsWrap;
   int ShowChannelNamesWithSource;
   int EmergencyExit;
+  int TsBufferSize;
+  int RecorderBufferSize;
+  int PlayerBufferSize;
+  int UseHugePages;
+  int MaxCopyRate;
   int __EndData__;
   cString InitialChannel;
   cString DeviceBondings;
@@ -364,4 +374,8 @@ public:
 
 extern cSetup Setup;
 
+#define MINBUFFERSIZE       1 // MB
+#define MAXBUFFERSIZE     512 // MB
+#define BUFFERSIZE(n)     MEGABYTE(constrain(n, MINBUFFERSIZE, MAXBUFFERSIZE))
+
 #endif //__CONFIG_H
@@ -218,6 +218,158 @@ void cMpeg2Fixer::AdjTref(int TrefOffset)
   SetByte((Tref << 6) | (Byte2 & 0x3F), Index2);
 }
 
+// --- cCutterReader ---------------------------------------------------------
+
+#define CUTTERREADAHEAD MEGABYTE(32) // the maximum amount of frame data read in advance
+
+class cCutterFrame : public cListObject {
+public:
+  int index;
+  uchar *data;
+  int length;
+  bool independent;
+  cCutterFrame(int Index, const uchar *Data, int Length, bool Independent);
+  virtual ~cCutterFrame();
+  };
+
+cCutterFrame::cCutterFrame(int Index, const uchar *Data, int Length, bool Independent)
+{
+  index = Index;
+  data = MALLOC(uchar, Length);
+  length = data ? Length : 0;
+  if (data)
+     memcpy(data, Data, length);
+  independent = Independent;
+}
+
+cCutterFrame::~cCutterFrame()
+{
+  free(data);
+}
+
+class cCutterReader : public cThread {
+private:
+  cFileName *fileName;
+  cIndexFile *index;
+  cMutex mutex;
+  cCondVar frameReady;
+  cCondVar frameTaken;
+  cList<cCutterFrame> frames;
+  int next;       // the next frame to be read
+  int end;        // the frame at which to stop reading (excluded)
+  int range;      // incremented whenever the range of frames to read is changed
+  int readAhead;  // the number of bytes read, but not yet taken
+  bool error;
+protected:
+  virtual void Action(void);
+public:
+  cCutterReader(const char *FileName, bool IsPesRecording);
+       ///< Creates a reader that loads the frames of the recording with the given
+       ///< FileName in advance, using its own file and index objects.
+  virtual ~cCutterReader();
+  void SetRange(int BeginIndex, int EndIndex);
+       ///< Discards any frames that have been read so far and starts reading the
+       ///< frames from BeginIndex (included) to EndIndex (excluded).
+  bool Get(int Index, uchar *Buffer, bool &Independent, int &Length);
+       ///< Copies the frame with the given Index into Buffer, waiting until it has
+       ///< been read. Frames must be taken in the order in which they are read.
+       ///< Returns false if the frame is not in the current range or couldn't be
+       ///< read, in which case the caller shall read it by itself.
+  };
+
+cCutterReader::cCutterReader(const char *FileName, bool IsPesRecording)
+:cThread("cutter reader", true)
+{
+  fileName = new cFileName(FileName, false, true, IsPesRecording);
+  index = new cIndexFile(FileName, false, IsPesRecording);
+  next = end = 0;
+  range = 0;
+  readAhead = 0;
+  error = false;
+  Start();
+}
+
+cCutterReader::~cCutterReader()
+{
+  Cancel(3);
+  delete fileName;
+  delete index;
+}
+
+void cCutterReader::SetRange(int BeginIndex, int EndIndex)
+{
+  cMutexLock MutexLock(&mutex);
+  frames.Clear();
+  next = BeginIndex;
+  end = EndIndex;
+  range++;
+  readAhead = 0;
+  error = false;
+  frameTaken.Broadcast();
+}
+
+bool cCutterReader::Get(int Index, uchar *Buffer, bool &Independent, int &Length)
+{
+  cMutexLock MutexLock(&mutex);
+  for (;;) {
+      cCutterFrame *Frame = frames.First();
+      if (Frame && Frame->index == Index) {
+         memcpy(Buffer, Frame->data, Frame->length);
+         Length = Frame->length;
+         Independent = Frame->independent;
+         readAhead -= Frame->length;
+         frames.Del(Frame);
+         frameTaken.Broadcast();
+         return true;
+         }
+      if (Frame || Index < next || Index >= end || error || !Active())
+         return false;
+      frameReady.TimedWait(mutex, 100);
+      }
+}
+
+void cCutterReader::Action(void)
+{
+  uchar *Buffer = MALLOC(uchar, MAXFRAMESIZE);
+  if (!Buffer)
+     return;
+  while (Running()) {
+        mutex.Lock();
+        if (next >= end || readAhead >= CUTTERREADAHEAD || error) {
+           frameTaken.TimedWait(mutex, 100);
+           mutex.Unlock();
+           continue;
+           }
+        int Index = next;
+        int Range = range;
+        mutex.Unlock();
+        uint16_t FileNumber;
+        off_t FileOffset;
+        bool Independent;
+        int Length;
+        bool Ok = false;
+        if (index->Get(Index, &FileNumber, &FileOffset, &Independent, &Length)) {
+           if (cUnbufferedFile *File = fileName->SetOffset(FileNumber, FileOffset)) {
+              File->SetReadAhead(MEGABYTE(20));
+              Length = ReadFrame(File, Buffer, Length, MAXFRAMESIZE);
+              Ok = Length >= 0;
+              }
+           }
+        cMutexLock MutexLock(&mutex);
+        if (Range == range) {
+           if (Ok) {
+              frames.Add(new cCutterFrame(Index, Buffer, Length, Independent));
+              readAhead += Length;
+              next++;
+              }
+           else
+              error = true; // the caller will run into this error when reading the frame by itself
+           frameReady.Broadcast();
+           }
+        }
+  free(Buffer);
+}
+
 // --- cCuttingThread --------------------------------------------------------
 
 class cCuttingThread : public cThread {
@@ -228,10 +380,13 @@ private:
   cUnbufferedFile *fromFile, *toFile;
   cFileName *fromFileName, *toFileName;
   cIndexFile *fromIndex, *toIndex;
+  cCutterReader *reader;
+  cRecordingWriter *writer;
   cMarks fromMarks, toMarks;
   int numSequences;
   off_t maxVideoFileSize;
-  off_t fileSize;
+  int toIndexLast;       // the last index entry written to the edited recording
+  off_t bytesProcessed;
   bool suspensionLogged;
   int sequence;          // cutting sequence
   int delta;             // time between two frames (PTS ticks)
@@ -245,7 +400,7 @@ private:
   int numIFrames;        // number of I-frames without pending packets
   cPatPmtParser patPmtParser;
   bool Throttled(void);
-  bool SwitchFile(bool Force = false);
+  void SwitchFile(bool Force = false);
   bool LoadFrame(int Index, uchar *Buffer, bool &Independent, int &Length);
   bool FramesAreEqual(int Index1, int Index2);
   void GetPendingPackets(uchar *Buffer, int &Length, int Index);
@@ -269,11 +424,14 @@ cCuttingThread::cCuttingThread(const char *FromFileName, const char *ToFileName)
   fromFile = toFile = NULL;
   fromFileName = toFileName = NULL;
   fromIndex = toIndex = NULL;
+  reader = NULL;
+  writer = NULL;
   cRecording Recording(FromFileName);
   isPesRecording = Recording.IsPesRecording();
   framesPerSecond = Recording.FramesPerSecond();
   suspensionLogged = false;
-  fileSize = 0;
+  toIndexLast = -1;
+  bytesProcessed = 0;
   sequence = 0;
   delta = int(round(PTSTICKS / framesPerSecond));
   lastVidPts = -1;
@@ -291,6 +449,7 @@ cCuttingThread::cCuttingThread(const char *FromFileName, const char *ToFileName)
         fromIndex = new cIndexFile(FromFileName, false, isPesRecording);
         toIndex = new cIndexFile(ToFileName, true, isPesRecording);
         toMarks.Load(ToFileName, framesPerSecond, isPesRecording); // doesn't actually load marks, just sets the file name
+        reader = new cCutterReader(FromFileName, isPesRecording);
         maxVideoFileSize = MEGABYTE(Setup.MaxVideoFileSize);
         if (isPesRecording && maxVideoFileSize > MEGABYTE(MAXVIDEOFILESIZEPES))
            maxVideoFileSize = MEGABYTE(MAXVIDEOFILESIZEPES);
@@ -306,6 +465,8 @@ cCuttingThread::cCuttingThread(const char *FromFileName, const char *ToFileName)
 cCuttingThread::~cCuttingThread()
 {
   Cancel(3);
+  delete reader;
+  delete writer;
   delete fromFileName;
   delete toFileName;
   delete fromIndex;
@@ -349,17 +510,12 @@ bool cCuttingThread::LoadFrame(int Index, uchar *Buffer, bool &Independent, int
   return false;
 }
 
-bool cCuttingThread::SwitchFile(bool Force)
+void cCuttingThread::SwitchFile(bool Force)
 {
-  if (fileSize > maxVideoFileSize || Force) {
-     toFile = toFileName->NextFile();
-     if (!toFile) {
-        error = "toFile";
-        return false;
-        }
-     fileSize = 0;
-     }
-  return true;
+  // The next file is opened by the writer's thread, so any error in doing so
+  // is only reported later, through writer->Error():
+  if (writer->FileSize() > maxVideoFileSize || Force)
+     writer->NextFile();
 }
 
 class cHeapBuffer {
@@ -552,10 +708,12 @@ bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIn
      error = "malloc";
      return false;
      }
+  // Have the reader load the frames of this sequence while we are processing them:
+  reader->SetRange(BeginIndex, EndIndex);
   for (int Index = BeginIndex; Running() && Index < EndIndex; Index++) {
       bool Independent;
       int Length;
-      if (LoadFrame(Index, Buffer, Independent, Length)) {
+      if (reader->Get(Index, Buffer, Independent, Length) || LoadFrame(Index, Buffer, Independent, Length)) {
          // Make sure there is enough disk space:
          AssertFreeDiskSpace(-1);
          bool CutIn = !SeamlessBegin && Index == BeginIndex;
@@ -567,26 +725,30 @@ bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIn
          else if (CutIn)
             cRemux::SetBrokenLink(Buffer, Length);
          // Every file shall start with an independent frame:
-         if (Independent) {
-            if (!SwitchFile())
-               return false;
+         if (Independent)
+            SwitchFile();
+         // Don't let the writer fall too far behind:
+         while (!writer->WaitForSpace(100)) {
+               if (!Running())
+                  return false;
+               }
+         if (writer->Error()) {
+            error = "safe_write";
+            return false;
             }
          // Write index:
-         if (!DeletedFrame && !toIndex->Write(Independent, toFileName->Number(), fileSize)) {
-            error = "toIndex";
-            return false;
+         if (!DeletedFrame) {
+            writer->WriteIndex(Independent);
+            toIndexLast++;
             }
          // Write data:
-         if (toFile->Write(Buffer, Length) < 0) {
-            error = "safe_write";
-            return false;
-            }
-         fileSize += Length;
+         writer->Write(Buffer, Length);
+         bytesProcessed += Length;
          // Generate marks at the editing points in the edited recording:
          if (numSequences > 1 && Index == BeginIndex) {
             if (toMarks.Count() > 0)
-               toMarks.Add(toIndex->Last());
-            toMarks.Add(toIndex->Last());
+               toMarks.Add(toIndexLast);
+            toMarks.Add(toIndexLast);
             toMarks.Save();
             }
          }
@@ -603,6 +765,10 @@ void cCuttingThread::Action(void)
      toFile = toFileName->Open();
      if (!fromFile || !toFile)
         return;
+     // The edited recording is written by a separate thread, so that reading,
+     // fixing and writing the frames can be done in parallel:
+     writer = new cRecordingWriter(toFileName, toIndex);
+     cTimeMs Timer;
      int LastEndIndex = -1;
      while (BeginMark && Running()) {
            // Suspend cutting if we have severe throughput problems:
@@ -628,12 +794,17 @@ void cCuttingThread::Action(void)
            BeginMark = fromMarks.GetNextBegin(EndMark);
            if (BeginMark) {
               // Split edited files:
-              if (Setup.SplitEditedFiles) {
-                 if (!SwitchFile(true))
-                    break;
-                 }
+              if (Setup.SplitEditedFiles)
+                 SwitchFile(true);
               }
            }
+     if (!writer->Flush() && !error)
+        error = "safe_write";
+     DELETENULL(writer);
+     if (!error && Running()) {
+        double Seconds = max(Timer.Elapsed(), uint64_t(1)) / 1000.0;
+        isyslog("edited %d MB in %.1f s (%.1f MB/s)", int(bytesProcessed / MEGABYTE(1)), Seconds, bytesProcessed / Seconds / MEGABYTE(1));
+        }
      Recordings.TouchUpdate();
      }
   else
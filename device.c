@@ -104,8 +104,11 @@ cDevice::cDevice(void)
   dvbSubtitleConverter = NULL;
   autoSelectPreferredSubtitleLanguage = true;
 
-  for (int i = 0; i < MAXRECEIVERS; i++)
+  for (int i = 0; i < MAXRECEIVERS; i++) {
       receiver[i] = NULL;
+      sharedFrom[i] = -1;
+      }
+  memset(receiverMask, 0, sizeof(receiverMask));
 
   if (numDevices < MAXDEVICES)
      device[numDevices++] = this;
@@ -1571,15 +1574,20 @@ bool cDevice::Receiving(bool Dummy) const
 
 #define TS_SCRAMBLING_TIMEOUT     3 // seconds to wait until a TS becomes unscrambled
 #define TS_SCRAMBLING_TIME_OK    10 // seconds before a Channel/CAM combination is marked as known to decrypt
+#define TS_BLOCK_PACKETS        256 // max. number of TS packets distributed to the receivers in one block
 
 void cDevice::Action(void)
 {
   if (Running() && OpenDvr()) {
      while (Running()) {
-           // Read data from the DVR device:
+           // Read data from the DVR device (while scramble detection is active,
+           // each single packet needs to be inspected):
            uchar *b = NULL;
-           if (GetTSPacket(b)) {
-              if (b) {
+           int Count = startScrambleDetection ? 1 : TS_BLOCK_PACKETS;
+           if (Count == 1 ? GetTSPacket(b) : GetTSPackets(b, Count)) {
+              if (b && Count > 1)
+                 DistributeTSPackets(b, Count);
+              else if (b) {
                  int Pid = TsPid(b);
                  // Check whether the TS packets are scrambled:
                  bool DetachReceivers = false;
@@ -1603,8 +1611,9 @@ void cDevice::Action(void)
                     }
                  // Distribute the packet to all attached receivers:
                  Lock();
-                 for (int i = 0; i < MAXRECEIVERS; i++) {
-                     if (receiver[i] && receiver[i]->WantsPid(Pid)) {
+                 uint32_t Mask = receiverMask[Pid];
+                 for (int i = 0; Mask; i++, Mask >>= 1) {
+                     if ((Mask & 1) && receiver[i]) {
                         if (DetachReceivers && cs && (!cs->IsActivating() || receiver[i]->Priority() >= LIVEPRIORITY)) {
                            dsyslog("detaching receiver - won't decrypt channel %s with CAM %d", *receiver[i]->ChannelID().ToString(), CamSlotNumber);
                            ChannelCamRelations.SetChecked(receiver[i]->ChannelID(), CamSlotNumber);
@@ -1635,11 +1644,57 @@ void cDevice::CloseDvr(void)
 {
 }
 
+void cDevice::DistributeTSPackets(uchar *Data, int Count)
+{
+  // Hands each receiver the longest runs of consecutive packets it wants,
+  // so that the original order of the packets is preserved:
+  int First[MAXRECEIVERS];
+  uint32_t Pending = 0;
+  Lock();
+  for (int n = 0; n <= Count; n++) {
+      uint32_t Mask = n < Count ? receiverMask[TsPid(Data + n * TS_SIZE)] : 0;
+      uint32_t Done = Pending & ~Mask;
+      for (int i = 0; Done; i++, Done >>= 1) {
+          if ((Done & 1) && receiver[i])
+             receiver[i]->ReceiveBlock(Data + First[i] * TS_SIZE, (n - First[i]) * TS_SIZE);
+          }
+      uint32_t New = Mask & ~Pending;
+      for (int i = 0; New; i++, New >>= 1) {
+          if (New & 1)
+             First[i] = n;
+          }
+      Pending = Mask;
+      }
+  Unlock();
+}
+
 bool cDevice::GetTSPacket(uchar *&Data)
 {
   return false;
 }
 
+bool cDevice::GetTSPackets(uchar *&Data, int &Count)
+{
+  Data = NULL;
+  bool Result = GetTSPacket(Data);
+  Count = Data ? 1 : 0;
+  return Result;
+}
+
+void cDevice::SetReceiverMask(int Index, bool On)
+{
+  // Must be called while the device is locked!
+  uint32_t Bit = 1 << Index;
+  cReceiver *Receiver = receiver[Index];
+  for (int n = 0; n < Receiver->numPids; n++) {
+      int Pid = Receiver->pids[n] & (MAXPID - 1);
+      if (On)
+         receiverMask[Pid] |= Bit;
+      else
+         receiverMask[Pid] &= ~Bit;
+      }
+}
+
 bool cDevice::AttachReceiver(cReceiver *Receiver)
 {
   if (!Receiver)
@@ -1665,10 +1720,21 @@ bool cDevice::AttachReceiver(cReceiver *Receiver)
                 return false;
                 }
              }
+         // Check whether an attached receiver can share its data with the new one:
+         int SharedFrom = -1;
+         for (int j = 0; j < MAXRECEIVERS; j++) {
+             if (receiver[j] && sharedFrom[j] < 0 && receiver[j]->WantsSamePids(Receiver) && receiver[j]->ShareData(Receiver)) {
+                SharedFrom = j;
+                break;
+                }
+             }
          Receiver->Activate(true);
          Lock();
          Receiver->device = this;
          receiver[i] = Receiver;
+         sharedFrom[i] = SharedFrom;
+         if (SharedFrom < 0)
+            SetReceiverMask(i, true);
          Unlock();
          if (camSlot && Receiver->priority > MINPRIORITY) { // priority check to avoid an infinite loop with the CAM slot's caPidReceiver
             camSlot->StartDecrypting();
@@ -1691,6 +1757,23 @@ void cDevice::Detach(cReceiver *Receiver)
   for (int i = 0; i < MAXRECEIVERS; i++) {
       if (receiver[i] == Receiver) {
          Lock();
+         if (sharedFrom[i] < 0) {
+            SetReceiverMask(i, false);
+            // Let one of the receivers that share this receiver's data take over:
+            int NewSource = -1;
+            for (int j = 0; j < MAXRECEIVERS; j++) {
+                if (receiver[j] && sharedFrom[j] == i) {
+                   if (NewSource < 0) {
+                      NewSource = j;
+                      sharedFrom[j] = -1;
+                      SetReceiverMask(j, true);
+                      }
+                   else
+                      sharedFrom[j] = NewSource;
+                   }
+                }
+            }
+         sharedFrom[i] = -1;
          receiver[i] = NULL;
          Receiver->device = NULL;
          Unlock();
@@ -1738,7 +1821,7 @@ cTSBuffer::cTSBuffer(int File, int Size, int CardIndex)
   SetDescription("device %d TS buffer", CardIndex);
   f = File;
   cardIndex = CardIndex;
-  delivered = false;
+  delivered = 0;
   ringBuffer = new cRingBufferLinear(Size, TS_SIZE, true, "TS");
   ringBuffer->SetTimeouts(100, 100);
   ringBuffer->SetIoThrottle();
@@ -1777,23 +1860,19 @@ uchar *cTSBuffer::Get(int *Available)
 {
   int Count = 0;
   if (delivered) {
-     ringBuffer->Del(TS_SIZE);
-     delivered = false;
+     ringBuffer->Del(delivered);
+     delivered = 0;
      }
   uchar *p = ringBuffer->Get(Count);
   if (p && Count >= TS_SIZE) {
      if (*p != TS_SYNC_BYTE) {
-        for (int i = 1; i < Count; i++) {
-            if (p[i] == TS_SYNC_BYTE) {
-               Count = i;
-               break;
-               }
-            }
+        if (uchar *s = (uchar *)memchr(p + 1, TS_SYNC_BYTE, Count - 1))
+           Count = s - p;
         ringBuffer->Del(Count);
         esyslog("ERROR: skipped %d bytes to sync on TS packet on device %d", Count, cardIndex);
         return NULL;
         }
-     delivered = true;
+     delivered = TS_SIZE;
      if (Available)
         *Available = Count;
      return p;
@@ -1803,6 +1882,5 @@ uchar *cTSBuffer::Get(int *Available)
 
 void cTSBuffer::Skip(int Count)
 {
-  ringBuffer->Del(Count);
-  delivered = false;
+  delivered = Count;
 }
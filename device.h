@@ -28,7 +28,7 @@
 
 #define MAXDEVICES         16 // the maximum number of devices in the system
 #define MAXPIDHANDLES      64 // the maximum number of different PIDs per device
-#define MAXRECEIVERS       16 // the maximum number of receivers per device
+#define MAXRECEIVERS       16 // the maximum number of receivers per device (must not exceed 32, see cDevice::receiverMask)
 #define MAXVOLUME         255
 #define VOLUMEDELTA       (MAXVOLUME / Setup.VolumeSteps) // used to increase/decrease the volume
 #define MAXOCCUPIEDTIMEOUT 99 // max. time (in seconds) a device may be occupied
@@ -793,6 +793,10 @@ public:
 private:
   mutable cMutex mutexReceiver;
   cReceiver *receiver[MAXRECEIVERS];
+  int sharedFrom[MAXRECEIVERS]; // index of the receiver that shares its data with receiver[i], or -1
+  uint32_t receiverMask[MAXPID]; // bit i is set if receiver[i] gets the PID used as the index delivered
+  void SetReceiverMask(int Index, bool On);
+  void DistributeTSPackets(uchar *Data, int Count);
 public:
   int Priority(void) const;
       ///< Returns the priority of the current receiving session (-MAXPRIORITY..MAXPRIORITY),
@@ -810,6 +814,15 @@ protected:
       ///< new data available, Data will be set to NULL. The function returns
       ///< false in case of a non recoverable error, otherwise it returns true,
       ///< even if Data is NULL.
+  virtual bool GetTSPackets(uchar *&Data, int &Count);
+      ///< Gets up to Count consecutive TS packets from the DVR of this device and
+      ///< returns a pointer to the first one in Data, and the actual number of
+      ///< packets in Count. The data remains valid until the next call to
+      ///< GetTSPacket() or GetTSPackets(). If there is currently no new data
+      ///< available, Data will be set to NULL and Count to 0. The return value
+      ///< has the same meaning as for GetTSPacket().
+      ///< The default implementation simply calls GetTSPacket(), so derived classes
+      ///< that can deliver several TS packets at once should reimplement this function.
 public:
   bool Receiving(bool Dummy = false) const;
        ///< Returns true if we are currently receiving. The parameter has no meaning (for backwards compatibility only).
@@ -835,7 +848,7 @@ class cTSBuffer : public cThread {
 private:
   int f;
   int cardIndex;
-  bool delivered;
+  int delivered;
   cRingBufferLinear *ringBuffer;
   virtual void Action(void);
 public:
@@ -854,7 +867,8 @@ public:
      ///< will disable the automatic incrementing of the data pointer as described
      ///< in Get() and skip the given number of bytes instead. Count may be 0 if the
      ///< caller wants the previous TS packet to be delivered again in the next call
-     ///< to Get().
+     ///< to Get(). The data is actually removed from the buffer with the next call
+     ///< to Get(), so it remains valid until then.
   };
 
 #endif //__DEVICE_H
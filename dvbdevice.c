@@ -1666,7 +1666,7 @@ bool cDvbDevice::OpenDvr(void)
   CloseDvr();
   fd_dvr = DvbOpen(DEV_DVB_DVR, adapter, frontend, O_RDONLY | O_NONBLOCK, true);
   if (fd_dvr >= 0)
-     tsBuffer = new cTSBuffer(fd_dvr, MEGABYTE(5), CardIndex() + 1);
+     tsBuffer = new cTSBuffer(fd_dvr, BUFFERSIZE(Setup.TsBufferSize), CardIndex() + 1);
   return fd_dvr >= 0;
 }
 
@@ -1700,6 +1700,29 @@ bool cDvbDevice::GetTSPacket(uchar *&Data)
   return false;
 }
 
+bool cDvbDevice::GetTSPackets(uchar *&Data, int &Count)
+{
+  if (tsBuffer) {
+     if (cCamSlot *cs = CamSlot()) {
+        if (cs->WantsTsData()) // the CAM decrypts one packet at a time
+           return cDevice::GetTSPackets(Data, Count);
+        }
+     int Available;
+     Data = tsBuffer->Get(&Available);
+     int n = 0;
+     if (Data) {
+        // Only deliver packets that are in sync, cTSBuffer::Get() takes care of the rest:
+        int Max = min(Count, Available / TS_SIZE);
+        for (n = 1; n < Max && Data[n * TS_SIZE] == TS_SYNC_BYTE; n++)
+            ;
+        tsBuffer->Skip(n * TS_SIZE);
+        }
+     Count = n;
+     return true;
+     }
+  return false;
+}
+
 void cDvbDevice::DetachAllReceivers(void)
 {
   cMutexLock MutexLock(&bondMutex);
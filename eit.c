@@ -23,13 +23,17 @@
 // --- cEIT ------------------------------------------------------------------
 
 class cEIT : public SI::EIT {
+private:
+  bool processed;
 public:
   cEIT(cSchedules *Schedules, int Source, u_char Tid, const u_char *Data, bool OnlyRunningStatus = false);
+  bool Processed(void) { return processed; }
   };
 
 cEIT::cEIT(cSchedules *Schedules, int Source, u_char Tid, const u_char *Data, bool OnlyRunningStatus)
 :SI::EIT(Data, false)
 {
+  processed = false;
   if (!CheckCRCAndParse())
      return;
 
@@ -122,11 +126,12 @@ cEIT::cEIT(cSchedules *Schedules, int Source, u_char Tid, const u_char *Data, bo
       int LanguagePreferenceExt = -1;
       bool UseExtendedEventDescriptor = false;
       SI::Descriptor *d;
+      SI::DescriptorBuffer DescriptorBuffer;
       SI::ExtendedEventDescriptors *ExtendedEventDescriptors = NULL;
       SI::ShortEventDescriptor *ShortEventDescriptor = NULL;
       cLinkChannels *LinkChannels = NULL;
       cComponents *Components = NULL;
-      for (SI::Loop::Iterator it2; (d = SiEitEvent.eventDescriptors.getNext(it2)); ) {
+      for (SI::Loop::Iterator it2; (d = SiEitEvent.eventDescriptors.getNext(it2, DescriptorBuffer)); ) {
           switch (d->getDescriptorTag()) {
             case SI::ExtendedEventDescriptorTag: {
                  SI::ExtendedEventDescriptor *eed = (SI::ExtendedEventDescriptor *)d;
@@ -136,8 +141,9 @@ cEIT::cEIT(cSchedules *Schedules, int Source, u_char Tid, const u_char *Data, bo
                     UseExtendedEventDescriptor = true;
                     }
                  if (UseExtendedEventDescriptor) {
-                    if (ExtendedEventDescriptors->Add(eed))
-                       d = NULL; // so that it is not deleted
+                    SI::Descriptor *Copy = DescriptorBuffer.detach();
+                    if (!ExtendedEventDescriptors->Add((SI::ExtendedEventDescriptor *)Copy))
+                       delete Copy;
                     }
                  if (eed->getDescriptorNumber() == eed->getLastDescriptorNumber())
                     UseExtendedEventDescriptor = false;
@@ -147,8 +153,7 @@ cEIT::cEIT(cSchedules *Schedules, int Source, u_char Tid, const u_char *Data, bo
                  SI::ShortEventDescriptor *sed = (SI::ShortEventDescriptor *)d;
                  if (I18nIsPreferredLanguage(Setup.EPGLanguages, sed->languageCode, LanguagePreferenceShort) || !ShortEventDescriptor) {
                     delete ShortEventDescriptor;
-                    ShortEventDescriptor = sed;
-                    d = NULL; // so that it is not deleted
+                    ShortEventDescriptor = (SI::ShortEventDescriptor *)DescriptorBuffer.detach();
                     }
                  }
                  break;
@@ -266,7 +271,6 @@ cEIT::cEIT(cSchedules *Schedules, int Source, u_char Tid, const u_char *Data, bo
                  break;
             default: ;
             }
-          delete d;
           }
 
       if (!rEvent) {
@@ -312,6 +316,7 @@ cEIT::cEIT(cSchedules *Schedules, int Source, u_char Tid, const u_char *Data, bo
      }
   Channels.Unlock();
   EpgHandlers.EndSegmentTransfer(Modified, OnlyRunningStatus);
+  processed = !OnlyRunningStatus;
 }
 
 // --- cTDT ------------------------------------------------------------------
@@ -362,11 +367,252 @@ cTDT::cTDT(const u_char *Data)
      }
 }
 
+// --- cEitSectionVersions ---------------------------------------------------
+
+#define EITSECTIONTIMEOUT  600 // seconds after which an unchanged EIT section is processed again (to refresh the 'seen' time of its events)
+#define EITSECTIONHASHSIZE 4096
+
+class cEitSection : public cListObject {
+public:
+  int source;
+  u_short nid;
+  u_short tid;
+  u_short sid;
+  u_char tableId;
+  u_char sectionNumber;
+  u_char version;
+  time_t processed;
+  unsigned int id;
+  cEitSection(int Source, const u_char *Data);
+  bool Is(int Source, const u_char *Data) const;
+  static unsigned int Id(const u_char *Data);
+  };
+
+// The fields of the EIT section header that are used here (see ETSI EN 300 468):
+#define EIT_TABLE_ID(d)       (d)[0]
+#define EIT_SERVICE_ID(d)     (((d)[3] << 8) | (d)[4])
+#define EIT_VERSION(d)        (((d)[5] >> 1) & 0x1F)
+#define EIT_SECTION_NUMBER(d) (d)[6]
+#define EIT_TS_ID(d)          (((d)[8] << 8) | (d)[9])
+#define EIT_NETWORK_ID(d)     (((d)[10] << 8) | (d)[11])
+
+cEitSection::cEitSection(int Source, const u_char *Data)
+{
+  source = Source;
+  nid = EIT_NETWORK_ID(Data);
+  tid = EIT_TS_ID(Data);
+  sid = EIT_SERVICE_ID(Data);
+  tableId = EIT_TABLE_ID(Data);
+  sectionNumber = EIT_SECTION_NUMBER(Data);
+  version = 0xFF;
+  processed = 0;
+  id = Id(Data);
+}
+
+bool cEitSection::Is(int Source, const u_char *Data) const
+{
+  return sid == EIT_SERVICE_ID(Data) && tableId == EIT_TABLE_ID(Data) && sectionNumber == EIT_SECTION_NUMBER(Data) && tid == EIT_TS_ID(Data) && nid == EIT_NETWORK_ID(Data) && source == Source;
+}
+
+unsigned int cEitSection::Id(const u_char *Data)
+{
+  return (EIT_SERVICE_ID(Data) << 16) ^ (EIT_TS_ID(Data) << 4) ^ (EIT_TABLE_ID(Data) << 8) ^ EIT_SECTION_NUMBER(Data);
+}
+
+int cEitSectionVersions::currentGeneration = 0;
+
+cEitSectionVersions::cEitSectionVersions(void)
+:sectionsHash(EITSECTIONHASHSIZE)
+{
+  generation = currentGeneration;
+}
+
+cEitSection *cEitSectionVersions::Get(int Source, const u_char *Data)
+{
+  if (generation != currentGeneration) {
+     sectionsHash.Clear();
+     sections.Clear();
+     generation = currentGeneration;
+     }
+  if (cList<cHashObject> *list = sectionsHash.GetList(cEitSection::Id(Data))) {
+     for (cHashObject *hobj = list->First(); hobj; hobj = list->Next(hobj)) {
+         cEitSection *Section = (cEitSection *)hobj->Object();
+         if (Section->Is(Source, Data))
+            return Section;
+         }
+     }
+  return NULL;
+}
+
+bool cEitSectionVersions::Changed(int Source, const u_char *Data)
+{
+  cMutexLock MutexLock(&mutex);
+  if (cEitSection *Section = Get(Source, Data))
+     return Section->version != EIT_VERSION(Data) || time(NULL) - Section->processed >= EITSECTIONTIMEOUT;
+  return true;
+}
+
+void cEitSectionVersions::Processed(int Source, const u_char *Data)
+{
+  cMutexLock MutexLock(&mutex);
+  time_t Now = time(NULL);
+  cEitSection *Section = Get(Source, Data);
+  if (Section)
+     sections.Del(Section, false); // 'sections' is kept in the order of the processing times
+  else {
+     // Sections that haven't been processed within EITSECTIONTIMEOUT would be
+     // processed again anyway, so there's no need to remember them any longer:
+     while (cEitSection *s = sections.First()) {
+           if (Now - s->processed < EITSECTIONTIMEOUT)
+              break;
+           sectionsHash.Del(s, s->id);
+           sections.Del(s);
+           }
+     Section = new cEitSection(Source, Data);
+     sectionsHash.Add(Section, Section->id);
+     }
+  sections.Add(Section);
+  Section->version = EIT_VERSION(Data);
+  Section->processed = Now;
+}
+
+// --- cEitProcessor ---------------------------------------------------------
+
+#define EITQUEUESIZE    2000 // max. number of EIT sections waiting to be processed
+#define EITBATCHSIZE     200 // max. number of sections of one service that are processed under one lock
+#define EITLOCKTIMEOUT   100 // ms to wait for the write lock on the schedules
+#define EITRETRYDELAY    100 // ms to wait before trying again if the write lock couldn't be obtained
+
+class cEitQueueEntry : public cListObject {
+public:
+  int source;
+  u_char tid;
+  u_char *data;
+  cEitQueueEntry(int Source, u_char Tid, const u_char *Data, int Length);
+  ~cEitQueueEntry();
+  bool SameService(const cEitQueueEntry *Entry) const;
+  };
+
+cEitQueueEntry::cEitQueueEntry(int Source, u_char Tid, const u_char *Data, int Length)
+{
+  source = Source;
+  tid = Tid;
+  data = MALLOC(u_char, Length);
+  if (data)
+     memcpy(data, Data, Length);
+}
+
+cEitQueueEntry::~cEitQueueEntry()
+{
+  free(data);
+}
+
+bool cEitQueueEntry::SameService(const cEitQueueEntry *Entry) const
+{
+  // service_id, transport_stream_id and original_network_id:
+  return source == Entry->source && memcmp(data + 3, Entry->data + 3, 2) == 0 && memcmp(data + 8, Entry->data + 8, 4) == 0;
+}
+
+cEitProcessor::cEitProcessor(cEitSectionVersions *SectionVersions)
+:cThread("EIT processor")
+{
+  sectionVersions = SectionVersions;
+}
+
+cEitProcessor::~cEitProcessor()
+{
+  Cancel(3);
+}
+
+bool cEitProcessor::Put(int Source, u_char Tid, const u_char *Data, int Length)
+{
+  if (Length < 14)
+     return true; // too short for an EIT section, nothing to do
+  cMutexLock MutexLock(&mutex);
+  if (queue.Count() >= EITQUEUESIZE)
+     return false;
+  cEitQueueEntry *Entry = new cEitQueueEntry(Source, Tid, Data, Length);
+  if (!Entry->data) {
+     delete Entry;
+     return false;
+     }
+  queue.Add(Entry);
+  if (!Active())
+     Start();
+  newSection.Broadcast();
+  return true;
+}
+
+bool cEitProcessor::ProcessBatch(cList<cEitQueueEntry> &Batch)
+{
+  cSchedulesLock SchedulesLock(true, EITLOCKTIMEOUT);
+  if (cSchedules *Schedules = (cSchedules *)cSchedules::Schedules(SchedulesLock)) {
+     for (cEitQueueEntry *e = Batch.First(); e; e = Batch.Next(e)) {
+         cEIT EIT(Schedules, e->source, e->tid, e->data);
+         if (e->tid >= 0x50 && EIT.Processed()) {
+            sectionVersions->Processed(e->source, e->data);
+            __atomic_add_fetch(&cEitFilter::numProcessed, 1, __ATOMIC_RELAXED);
+            }
+         }
+     return true;
+     }
+  // If we don't get a write lock, let's at least get a read lock, so
+  // that we can set the running status and 'seen' timestamp (well, actually
+  // with a read lock we shouldn't be doing that, but it's only integers that
+  // get changed, so it should be ok). The sections will be processed completely
+  // once the write lock can be obtained:
+  cSchedulesLock ReadLock;
+  if (cSchedules *Schedules = (cSchedules *)cSchedules::Schedules(ReadLock)) {
+     for (cEitQueueEntry *e = Batch.First(); e; e = Batch.Next(e))
+         cEIT EIT(Schedules, e->source, e->tid, e->data, true);
+     }
+  return false;
+}
+
+void cEitProcessor::Action(void)
+{
+  cList<cEitQueueEntry> Batch;
+  while (Running()) {
+        // Collect the oldest section and any further sections of the same service:
+        mutex.Lock();
+        if (cEitQueueEntry *First = queue.First()) {
+           for (cEitQueueEntry *e = First; e && Batch.Count() < EITBATCHSIZE; ) {
+               cEitQueueEntry *Next = queue.Next(e);
+               if (e == First || e->SameService(First)) {
+                  queue.Del(e, false);
+                  Batch.Add(e);
+                  }
+               e = Next;
+               }
+           }
+        else
+           newSection.TimedWait(mutex, 1000);
+        mutex.Unlock();
+        if (Batch.Count()) {
+           if (!ProcessBatch(Batch)) {
+              // Put the sections back at the front of the queue, so that they
+              // aren't lost, and try again a little later:
+              cMutexLock MutexLock(&mutex);
+              while (cEitQueueEntry *e = Batch.Last()) {
+                    Batch.Del(e, false);
+                    queue.Ins(e);
+                    }
+              newSection.TimedWait(mutex, EITRETRYDELAY);
+              }
+           Batch.Clear();
+           }
+        }
+}
+
 // --- cEitFilter ------------------------------------------------------------
 
 time_t cEitFilter::disableUntil = 0;
+int cEitFilter::numProcessed = 0;
+int cEitFilter::numSkipped = 0;
+int cEitFilter::numDropped = 0;
 
 cEitFilter::cEitFilter(void)
+:processor(&sectionVersions)
 {
   Set(0x12, 0x40, 0xC0);  // event info now&next actual/other TS (0x4E/0x4F), future actual/other TS (0x5X/0x6X)
   Set(0x14, 0x70);        // TDT
@@ -375,6 +621,14 @@ cEitFilter::cEitFilter(void)
 void cEitFilter::SetDisableUntil(time_t Time)
 {
   disableUntil = Time;
+  ResetSectionVersions();
+}
+
+void cEitFilter::GetStatistics(int &Processed, int &Skipped, int &Dropped)
+{
+  Processed = __atomic_load_n(&numProcessed, __ATOMIC_RELAXED);
+  Skipped = __atomic_load_n(&numSkipped, __ATOMIC_RELAXED);
+  Dropped = __atomic_load_n(&numDropped, __ATOMIC_RELAXED);
 }
 
 void cEitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length)
@@ -388,20 +642,16 @@ void cEitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
   switch (Pid) {
     case 0x12: {
          if (Tid >= 0x4E && Tid <= 0x6F) {
-            cSchedulesLock SchedulesLock(true, 10);
-            cSchedules *Schedules = (cSchedules *)cSchedules::Schedules(SchedulesLock);
-            if (Schedules)
-               cEIT EIT(Schedules, Source(), Tid, Data);
-            else {
-               // If we don't get a write lock, let's at least get a read lock, so
-               // that we can set the running status and 'seen' timestamp (well, actually
-               // with a read lock we shouldn't be doing that, but it's only integers that
-               // get changed, so it should be ok)
-               cSchedulesLock SchedulesLock;
-               cSchedules *Schedules = (cSchedules *)cSchedules::Schedules(SchedulesLock);
-               if (Schedules)
-                  cEIT EIT(Schedules, Source(), Tid, Data, true);
+            // The "present/following" tables are always processed, since they
+            // carry the running status and keep the 'present seen' time up to date:
+            if (Tid >= 0x50 && Length >= 14 && !sectionVersions.Changed(Source(), Data)) {
+               __atomic_add_fetch(&numSkipped, 1, __ATOMIC_RELAXED);
+               break;
                }
+            // The actual processing is done in a separate thread, so that slow EPG
+            // processing doesn't hold up the other filters of this device:
+            if (!processor.Put(Source(), Tid, Data, Length))
+               __atomic_add_fetch(&numDropped, 1, __ATOMIC_RELAXED);
             }
          }
          break;
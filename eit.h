@@ -11,15 +11,73 @@
 #define __EIT_H
 
 #include "filter.h"
+#include "thread.h"
+#include "tools.h"
+
+class cEitSection;
+
+class cEitSectionVersions {
+private:
+  cMutex mutex;
+  int generation;
+  cList<cEitSection> sections;
+  cHash<cEitSection> sectionsHash;
+  cEitSection *Get(int Source, const u_char *Data);
+  static int currentGeneration;
+public:
+  cEitSectionVersions(void);
+  bool Changed(int Source, const u_char *Data);
+       ///< Returns false if the EIT section in Data has already been processed with
+       ///< its current version number within the last EITSECTIONTIMEOUT seconds,
+       ///< which means that there is no need to process it again.
+  void Processed(int Source, const u_char *Data);
+       ///< Records that the EIT section in Data has been completely processed.
+       ///< Sections that haven't been processed within the last EITSECTIONTIMEOUT
+       ///< seconds are forgotten.
+  static void Reset(void) { currentGeneration++; }
+       ///< Forgets all section versions, so that all sections will be processed
+       ///< again (used when the EPG data has been cleared or needs to be rebuilt).
+  };
+
+class cEitQueueEntry;
+
+class cEitProcessor : public cThread {
+private:
+  cEitSectionVersions *sectionVersions;
+  cMutex mutex;
+  cCondVar newSection;
+  cList<cEitQueueEntry> queue;
+  bool ProcessBatch(cList<cEitQueueEntry> &Batch);
+protected:
+  virtual void Action(void);
+public:
+  cEitProcessor(cEitSectionVersions *SectionVersions);
+  virtual ~cEitProcessor();
+  bool Put(int Source, u_char Tid, const u_char *Data, int Length);
+       ///< Puts a copy of the given EIT section into the queue of sections that
+       ///< are waiting to be processed. Returns false if the queue is full, in
+       ///< which case the section is dropped. This function never blocks.
+  };
 
 class cEitFilter : public cFilter {
+  friend class cEitProcessor;
 private:
+  cEitSectionVersions sectionVersions;
+  cEitProcessor processor;
   static time_t disableUntil;
+  static int numProcessed;
+  static int numSkipped;
+  static int numDropped;
 protected:
   virtual void Process(u_short Pid, u_char Tid, const u_char *Data, int Length);
 public:
   cEitFilter(void);
   static void SetDisableUntil(time_t Time);
+  static void ResetSectionVersions(void) { cEitSectionVersions::Reset(); }
+  static void GetStatistics(int &Processed, int &Skipped, int &Dropped);
+       ///< Returns the number of EIT schedule sections that have been processed,
+       ///< skipped (because they had not changed) and dropped (because they
+       ///< couldn't be processed fast enough) since VDR was started.
   };
 
 #endif //__EIT_H
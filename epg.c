@@ -12,13 +12,20 @@
 
 #include "epg.h"
 #include <ctype.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
+#include <wctype.h>
 #include "libsi/si.h"
 #include "timers.h"
 
 #define RUNNINGSTATUSTIMEOUT 30 // seconds before the running status is considered unknown
-#define EPGDATAWRITEDELTA   600 // seconds between writing the epg.data file
+#define RUNNINGSTATUSOVERRUN 3600 // seconds a running event may overrun its scheduled end time
+#define EPGDATAWRITEDELTA   600 // seconds between writing the epg.data file and the EPG snapshot
 
 // --- tComponent ------------------------------------------------------------
 
@@ -109,8 +116,968 @@ tComponent *cComponents::GetComponent(int Index, uchar Stream, uchar Type)
   return NULL;
 }
 
+// --- cStringPool -----------------------------------------------------------
+
+// Titles and short texts of events repeat very often (think of series, news
+// and the like), so each distinct string is stored only once and shared by
+// all events that use it.
+
+#define STRINGPOOLMINSIZE 4096 // initial number of hash buckets
+
+class cStringPool {
+private:
+  struct tPooledString {
+    tPooledString *next;
+    unsigned int hash;
+    int refs;
+    char text[1];
+    };
+  cMutex mutex;
+  tPooledString **buckets;
+  int size;
+  int count;
+  static unsigned int Hash(const char *s);
+  static tPooledString *PooledString(const char *s) { return (tPooledString *)(s - offsetof(tPooledString, text)); }
+  void Grow(void);
+public:
+  cStringPool(void);
+  char *Get(const char *s);
+       ///< Returns a pooled copy of s, which must be given back through a call to Put().
+  void Put(const char *s);
+       ///< Gives back a string that was previously returned by Get().
+  char *Private(char *s);
+       ///< Gives back s and returns a private copy of it, which the caller may
+       ///< modify and must free().
+  };
+
+static cStringPool StringPool;
+
+cStringPool::cStringPool(void)
+{
+  buckets = NULL;
+  size = 0;
+  count = 0;
+}
+
+unsigned int cStringPool::Hash(const char *s)
+{
+  unsigned int h = 2166136261u; // FNV-1a
+  while (*s)
+        h = (h ^ uchar(*s++)) * 16777619u;
+  return h;
+}
+
+void cStringPool::Grow(void)
+{
+  int NewSize = size ? size * 2 : STRINGPOOLMINSIZE;
+  tPooledString **NewBuckets = (tPooledString **)calloc(NewSize, sizeof(tPooledString *));
+  if (!NewBuckets)
+     return; // we'll just have longer chains
+  for (int i = 0; i < size; i++) {
+      while (tPooledString *p = buckets[i]) {
+            buckets[i] = p->next;
+            p->next = NewBuckets[p->hash % NewSize];
+            NewBuckets[p->hash % NewSize] = p;
+            }
+      }
+  free(buckets);
+  buckets = NewBuckets;
+  size = NewSize;
+}
+
+char *cStringPool::Get(const char *s)
+{
+  if (!s)
+     return NULL;
+  cMutexLock MutexLock(&mutex);
+  if (count >= size)
+     Grow();
+  if (!buckets)
+     return strdup(s); // can't happen, but just in case...
+  unsigned int h = Hash(s);
+  tPooledString **b = &buckets[h % size];
+  for (tPooledString *p = *b; p; p = p->next) {
+      if (p->hash == h && strcmp(p->text, s) == 0) {
+         p->refs++;
+         return p->text;
+         }
+      }
+  int l = strlen(s);
+  tPooledString *p = (tPooledString *)malloc(offsetof(tPooledString, text) + l + 1);
+  if (!p)
+     return NULL;
+  memcpy(p->text, s, l + 1);
+  p->hash = h;
+  p->refs = 1;
+  p->next = *b;
+  *b = p;
+  count++;
+  return p->text;
+}
+
+void cStringPool::Put(const char *s)
+{
+  if (!s)
+     return;
+  cMutexLock MutexLock(&mutex);
+  tPooledString *p = PooledString(s);
+  if (--p->refs == 0) {
+     for (tPooledString **b = &buckets[p->hash % size]; *b; b = &(*b)->next) {
+         if (*b == p) {
+            *b = p->next;
+            break;
+            }
+         }
+     free(p);
+     count--;
+     }
+}
+
+char *cStringPool::Private(char *s)
+{
+  char *p = s ? strdup(s) : NULL;
+  Put(s);
+  return p;
+}
+
+// --- cEpgWords -------------------------------------------------------------
+
+#define EPGINDEXMINWORD       2 // words shorter than this (in bytes) are not indexed
+#define EPGINDEXMAXWORD      32 // words longer than this (in symbols) are truncated
+
+// Splits a text into lowercase words, ignoring any punctuation.
+
+class cEpgWords {
+private:
+  const char *s;
+  int minLength;
+  char word[Utf8BufSize(EPGINDEXMAXWORD) + 1];
+public:
+  cEpgWords(const char *Text, int MinLength = EPGINDEXMINWORD) { s = Text ? Text : ""; minLength = MinLength; }
+  const char *Next(void);
+       ///< Returns the next word, or NULL if there are no more words.
+  };
+
+const char *cEpgWords::Next(void)
+{
+  while (*s) {
+        int n = 0;
+        int Symbols = 0;
+        while (*s) {
+              int l = Utf8CharLen(s);
+              uint c = Utf8CharGet(s, l);
+              s += l;
+              if (!Utf8is(alnum, c)) {
+                 if (n)
+                    break;
+                 continue;
+                 }
+              if (Symbols++ < EPGINDEXMAXWORD)
+                 n += Utf8CharSet(Utf8to(lower, c), word + n);
+              }
+        if (n >= minLength) {
+           word[n] = 0;
+           return word;
+           }
+        }
+  return NULL;
+}
+
+// --- cEpgText --------------------------------------------------------------
+
+// Holds texts as a sequence of lowercase words, separated and enclosed by blanks,
+// so that a phrase can be looked up with strstr(). Separate texts are separated
+// by a newline.
+
+class cEpgText {
+private:
+  char *text;
+  int length;
+  int size;
+  void Add(const char *s);
+public:
+  cEpgText(void) { text = NULL; length = size = 0; Add(" "); }
+  ~cEpgText() { free(text); }
+  void Append(const char *s);
+  const char *Text(void) const { return text ? text : ""; }
+  };
+
+void cEpgText::Add(const char *s)
+{
+  int l = strlen(s);
+  if (length + l >= size) {
+     int NewSize = max(size * 2, length + l + 256);
+     if (char *NewText = (char *)realloc(text, NewSize)) {
+        text = NewText;
+        size = NewSize;
+        }
+     else
+        return;
+     }
+  memcpy(text + length, s, l + 1);
+  length += l;
+}
+
+void cEpgText::Append(const char *s)
+{
+  if (length > 1)
+     Add("\n ");
+  cEpgWords Words(s, 1);
+  while (const char *w = Words.Next()) {
+        Add(w);
+        Add(" ");
+        }
+}
+
+// --- cEpgQuery -------------------------------------------------------------
+
+cEpgQuery::cEpgQuery(const char *Query)
+{
+  channels = NULL;
+  numChannels = 0;
+  from = to = 0;
+  if (Query) {
+     // Text in double quotes is a phrase, everything else is taken word by word:
+     char *q = strdup(Query);
+     char *p = q;
+     bool Quoted = false;
+     for (;;) {
+         char *e = strchr(p, '"');
+         if (e)
+            *e = 0;
+         if (Quoted)
+            AddPhrase(p);
+         else {
+            cEpgWords Words(p, 1);
+            while (const char *w = Words.Next())
+                  AddTerm(w);
+            }
+         if (!e)
+            break;
+         p = e + 1;
+         Quoted = !Quoted;
+         }
+     free(q);
+     }
+}
+
+cEpgQuery::~cEpgQuery()
+{
+  free(channels);
+}
+
+void cEpgQuery::AddTerm(const char *Term)
+{
+  cEpgWords Words(Term, 1);
+  if (const char *w = Words.Next()) {
+     cString Word = w;
+     if (Words.Next())
+        AddPhrase(Term);
+     else if (strlen(Word) < EPGINDEXMINWORD)
+        AddPhrase(Word); // short words aren't indexed
+     else if (words.Find(Word) < 0)
+        words.Append(strdup(Word));
+     }
+}
+
+void cEpgQuery::AddPhrase(const char *Phrase)
+{
+  // Phrases are stored as their words separated (and enclosed) by blanks:
+  cEpgText Text;
+  Text.Append(Phrase);
+  cEpgWords w(Phrase, 1);
+  while (const char *p = w.Next()) {
+        if (strlen(p) >= EPGINDEXMINWORD && words.Find(p) < 0)
+           words.Append(strdup(p)); // the index helps finding candidates for the phrase
+        }
+  if (strlen(Text.Text()) > 1 && phrases.Find(Text.Text()) < 0)
+     phrases.Append(strdup(Text.Text()));
+}
+
+void cEpgQuery::AddChannel(tChannelID ChannelID)
+{
+  if (tChannelID *NewChannels = (tChannelID *)realloc(channels, (numChannels + 1) * sizeof(tChannelID))) {
+     channels = NewChannels;
+     channels[numChannels++] = ChannelID.ClrRid();
+     }
+}
+
+void cEpgQuery::SetTime(time_t From, time_t To)
+{
+  from = From;
+  to = To;
+}
+
+bool cEpgQuery::Matches(const cEvent *Event) const
+{
+  // The words have already been checked by the index.
+  if (!Event->StartTime())
+     return false; // this event has been "phased out"
+  if (from && Event->EndTime() <= from)
+     return false;
+  if (to && Event->StartTime() >= to)
+     return false;
+  if (numChannels) {
+     tChannelID ChannelID = Event->ChannelID();
+     int i = 0;
+     while (i < numChannels && !(channels[i] == ChannelID))
+           i++;
+     if (i >= numChannels)
+        return false;
+     }
+  if (phrases.Size()) {
+     // Phrases must not span the title, short text and description:
+     cEpgText Text;
+     Text.Append(Event->Title());
+     Text.Append(Event->ShortText());
+     Text.Append(Event->Description());
+     for (int i = 0; i < phrases.Size(); i++) {
+         if (!strstr(Text.Text(), phrases[i]))
+            return false;
+         }
+     }
+  return true;
+}
+
+// --- cEpgIndex -------------------------------------------------------------
+
+// An inverted index of all words in the titles, short texts and descriptions
+// of the events in the schedules. Each event occupies a slot, and for every word
+// the slots of the events that contain it are kept in ascending order. When an
+// event is deleted (or its texts change), its slot is just marked as unused, and
+// the index is compacted once there are too many unused slots.
+// The index has its own lock, so that cEpgBatch can add the events it has
+// imported while only holding a read lock on the schedules.
+
+#define EPGINDEXMINSIZE    4096 // initial number of hash buckets
+#define EPGINDEXMINUNUSED 10000 // minimum number of unused slots before compacting the index
+
+class cEpgIndex {
+private:
+  struct tTerm {
+    tTerm *next;
+    unsigned int hash;
+    int *slots;
+    int count;
+    int allocated;
+    char text[1];
+    };
+  tTerm **buckets;
+  int size;
+  int numTerms;
+  cVector<cEvent *> events;
+  int unused;
+  mutable cMutex mutex;
+  static unsigned int Hash(const char *s);
+  void Grow(void);
+  tTerm *FindTerm(const char *Word, unsigned int Hash) const;
+  tTerm *GetTerm(const char *Word);
+  void Compact(void);
+public:
+  cEpgIndex(void);
+  void Add(cEvent *Event);
+  void Del(cEvent *Event);
+  int Search(const cEpgQuery &Query, cVector<const cEvent *> &Events) const;
+  };
+
+static cEpgIndex EpgIndex;
+
+cEpgIndex::cEpgIndex(void)
+{
+  buckets = NULL;
+  size = 0;
+  numTerms = 0;
+  unused = 0;
+}
+
+void cEpgIndex::Grow(void)
+{
+  int NewSize = size ? size * 2 : EPGINDEXMINSIZE;
+  tTerm **NewBuckets = (tTerm **)calloc(NewSize, sizeof(tTerm *));
+  if (!NewBuckets)
+     return; // we'll just have longer chains
+  for (int i = 0; i < size; i++) {
+      while (tTerm *t = buckets[i]) {
+            buckets[i] = t->next;
+            t->next = NewBuckets[t->hash % NewSize];
+            NewBuckets[t->hash % NewSize] = t;
+            }
+      }
+  free(buckets);
+  buckets = NewBuckets;
+  size = NewSize;
+}
+
+unsigned int cEpgIndex::Hash(const char *s)
+{
+  unsigned int h = 2166136261u; // FNV-1a
+  while (*s)
+        h = (h ^ uchar(*s++)) * 16777619u;
+  return h;
+}
+
+cEpgIndex::tTerm *cEpgIndex::FindTerm(const char *Word, unsigned int Hash) const
+{
+  if (buckets) {
+     for (tTerm *t = buckets[Hash % size]; t; t = t->next) {
+         if (t->hash == Hash && strcmp(t->text, Word) == 0)
+            return t;
+         }
+     }
+  return NULL;
+}
+
+cEpgIndex::tTerm *cEpgIndex::GetTerm(const char *Word)
+{
+  unsigned int h = Hash(Word);
+  if (tTerm *t = FindTerm(Word, h))
+     return t;
+  if (numTerms >= size)
+     Grow();
+  if (!buckets)
+     return NULL;
+  tTerm **b = &buckets[h % size];
+  int l = strlen(Word);
+  tTerm *t = (tTerm *)malloc(offsetof(tTerm, text) + l + 1);
+  if (!t)
+     return NULL;
+  memcpy(t->text, Word, l + 1);
+  t->hash = h;
+  t->slots = NULL;
+  t->count = 0;
+  t->allocated = 0;
+  t->next = *b;
+  *b = t;
+  numTerms++;
+  return t;
+}
+
+void cEpgIndex::Add(cEvent *Event)
+{
+  cMutexLock MutexLock(&mutex);
+  if (Event->indexSlot >= 0)
+     return;
+  int Slot = events.Size();
+  events.Append(Event);
+  Event->indexSlot = Slot;
+  const char *Texts[] = { Event->Title(), Event->ShortText(), Event->Description() };
+  for (unsigned int i = 0; i < sizeof(Texts) / sizeof(Texts[0]); i++) {
+      cEpgWords Words(Texts[i]);
+      while (const char *w = Words.Next()) {
+            tTerm *t = GetTerm(w);
+            if (!t)
+               continue;
+            if (t->count && t->slots[t->count - 1] == Slot)
+               continue; // this word has already been seen in this event
+            if (t->count >= t->allocated) {
+               int NewAllocated = t->allocated ? t->allocated * 2 : 4;
+               int *NewSlots = (int *)realloc(t->slots, NewAllocated * sizeof(int));
+               if (!NewSlots)
+                  continue;
+               t->slots = NewSlots;
+               t->allocated = NewAllocated;
+               }
+            t->slots[t->count++] = Slot;
+            }
+      }
+}
+
+void cEpgIndex::Del(cEvent *Event)
+{
+  if (Event->indexSlot >= 0) {
+     cMutexLock MutexLock(&mutex);
+     events[Event->indexSlot] = NULL;
+     Event->indexSlot = -1;
+     if (++unused >= EPGINDEXMINUNUSED && unused > events.Size() / 2)
+        Compact();
+     }
+}
+
+void cEpgIndex::Compact(void)
+{
+  // Assigns new slots to the remaining events and drops the unused slots and
+  // any words that are no longer used:
+  int n = events.Size();
+  int *NewSlot = MALLOC(int, n);
+  if (!NewSlot)
+     return;
+  int Used = 0;
+  for (int i = 0; i < n; i++) {
+      cEvent *Event = events[i];
+      if (Event) {
+         NewSlot[i] = Used;
+         Event->indexSlot = Used;
+         events[Used++] = Event;
+         }
+      else
+         NewSlot[i] = -1;
+      }
+  while (events.Size() > Used)
+        events.Remove(events.Size() - 1);
+  for (int i = 0; i < size; i++) {
+      for (tTerm **b = &buckets[i]; *b; ) {
+          tTerm *t = *b;
+          int Count = 0;
+          for (int j = 0; j < t->count; j++) {
+              int Slot = NewSlot[t->slots[j]];
+              if (Slot >= 0)
+                 t->slots[Count++] = Slot;
+              }
+          t->count = Count;
+          if (Count == 0) {
+             *b = t->next;
+             free(t->slots);
+             free(t);
+             numTerms--;
+             }
+          else
+             b = &t->next;
+          }
+      }
+  free(NewSlot);
+  unused = 0;
+}
+
+static int CompareEventsByStartTime(const void *a, const void *b)
+{
+  const cEvent *ea = *(const cEvent **)a;
+  const cEvent *eb = *(const cEvent **)b;
+  if (ea->StartTime() != eb->StartTime())
+     return ea->StartTime() < eb->StartTime() ? -1 : 1;
+  return ea->EventID() < eb->EventID() ? -1 : ea->EventID() > eb->EventID();
+}
+
+int cEpgIndex::Search(const cEpgQuery &Query, cVector<const cEvent *> &Events) const
+{
+  cMutexLock MutexLock(&mutex);
+  int Found = 0;
+  int n = Query.words.Size();
+  if (n == 0) {
+     // Nothing to look up in the index, so all events need to be checked:
+     for (int i = 0; i < events.Size(); i++) {
+         const cEvent *Event = events[i];
+         if (Event && Query.Matches(Event)) {
+            Events.Append(Event);
+            Found++;
+            }
+         }
+     return Found;
+     }
+  // Get the terms for all words, ordered by the number of events they occur in:
+  tTerm *Terms[n];
+  int Next[n];
+  for (int i = 0; i < n; i++) {
+      tTerm *t = FindTerm(Query.words[i], Hash(Query.words[i]));
+      if (!t)
+         return 0; // this word doesn't occur anywhere
+      int j = i;
+      while (j > 0 && Terms[j - 1]->count > t->count) {
+            Terms[j] = Terms[j - 1];
+            j--;
+            }
+      Terms[j] = t;
+      Next[i] = 0;
+      }
+  // Intersect the slots, starting with the shortest list:
+  for (int k = 0; k < Terms[0]->count; k++) {
+      int Slot = Terms[0]->slots[k];
+      bool Match = true;
+      for (int i = 1; i < n && Match; i++) {
+          // Binary search for the first slot at or after Slot:
+          tTerm *t = Terms[i];
+          int Lo = Next[i];
+          int Hi = t->count;
+          while (Lo < Hi) {
+                int Mid = (Lo + Hi) / 2;
+                if (t->slots[Mid] < Slot)
+                   Lo = Mid + 1;
+                else
+                   Hi = Mid;
+                }
+          Next[i] = Lo;
+          if (Lo >= t->count) {
+             k = Terms[0]->count; // none of the remaining slots can match
+             Match = false;
+             }
+          else if (t->slots[Lo] != Slot)
+             Match = false;
+          }
+      if (Match) {
+         const cEvent *Event = events[Slot];
+         if (Event && Query.Matches(Event)) {
+            Events.Append(Event);
+            Found++;
+            }
+         }
+      }
+  return Found;
+}
+
+// --- cEpgSnapshot ----------------------------------------------------------
+
+// The binary EPG snapshot holds the same data as the text file 'epg.data', but
+// can be read much faster at startup. It is mapped into memory and the event
+// descriptions are used right from there, so they are only actually read from
+// disk when they are accessed. When writing the snapshot, the data of
+// schedules that haven't changed since it was last written is copied from the
+// previous file.
+//
+// File layout (in the native byte order of the machine that wrote it):
+//   tEpgSnapshotHeader
+//   for each schedule: tEpgSnapshotSchedule, channel ID (0 terminated),
+//     for each event: tEpgSnapshotEvent, title, short text, description and
+//       the components in the format of tComponent::ToString() (each 0 terminated)
+
+#define EPGSNAPSHOTMAGIC     "VDR-EPG\n"
+#define EPGSNAPSHOTVERSION   1
+#define EPGSNAPSHOTBYTEORDER 0x01020304
+
+struct tEpgSnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  };
+
+struct tEpgSnapshotSchedule {
+  uint32_t length; // total length of this schedule's data, including this header
+  uint32_t numEvents;
+  };
+
+struct tEpgSnapshotEvent {
+  int64_t startTime;
+  int64_t vps;
+  uint32_t eventID;
+  int32_t duration;
+  uint16_t numComponents;
+  uchar tableID;
+  uchar version;
+  uchar parentalRating;
+  uchar contents[MaxEventContents];
+  };
+
+class cEpgSnapshotEntry : public cListObject {
+public:
+  tChannelID channelID;
+  off_t offset;
+  int length;
+  int numEvents; // the number of events in the schedule at the time it was written
+  time_t written;
+  cEpgSnapshotEntry(tChannelID ChannelID, off_t Offset, int Length, int NumEvents, time_t Written) { channelID = ChannelID; offset = Offset; length = Length; numEvents = NumEvents; written = Written; }
+  };
+
+class cEpgSnapshot {
+private:
+  static char *data;
+  static size_t size;
+  static bool invalid;
+  static cList<cEpgSnapshotEntry> entries;
+  static cEpgSnapshotEntry *GetEntry(tChannelID ChannelID);
+  static const char *GetString(const char *&p, const char *End);
+  static bool ReadSchedule(cSchedules *Schedules, const char *&p, const char *End, off_t Offset, time_t Now);
+  static bool WriteString(FILE *f, const char *s);
+  static bool WriteSchedule(FILE *f, const cSchedule *Schedule, time_t Now);
+public:
+  static bool Contains(const char *s) { return s && s >= data && s < data + size; }
+       ///< Returns true if s points into the snapshot that has been read at startup.
+  static bool Read(cSchedules *Schedules, const char *FileName);
+       ///< Reads the snapshot with the given FileName into Schedules.
+       ///< Must be called with Schedules locked for writing.
+  static bool Write(const char *FileName);
+       ///< Writes all of Schedules to a snapshot with the given FileName.
+       ///< Must be called with Schedules locked (at least for reading).
+  static void Invalidate(void) { invalid = true; }
+       ///< Makes the next call to Write() write all schedules anew.
+  };
+
+char *cEpgSnapshot::data = NULL;
+size_t cEpgSnapshot::size = 0;
+bool cEpgSnapshot::invalid = false;
+cList<cEpgSnapshotEntry> cEpgSnapshot::entries;
+
+cEpgSnapshotEntry *cEpgSnapshot::GetEntry(tChannelID ChannelID)
+{
+  for (cEpgSnapshotEntry *e = entries.First(); e; e = entries.Next(e)) {
+      if (e->channelID == ChannelID)
+         return e;
+      }
+  return NULL;
+}
+
+const char *cEpgSnapshot::GetString(const char *&p, const char *End)
+{
+  const char *s = p;
+  const char *e = (const char *)memchr(p, 0, End - p);
+  if (!e)
+     return NULL;
+  p = e + 1;
+  return s;
+}
+
+bool cEpgSnapshot::ReadSchedule(cSchedules *Schedules, const char *&p, const char *End, off_t Offset, time_t Now)
+{
+  tEpgSnapshotSchedule ss;
+  if (End - p < int(sizeof(ss)))
+     return false;
+  memcpy(&ss, p, sizeof(ss));
+  if (ss.length < sizeof(ss) || ss.length > size_t(End - p))
+     return false;
+  const char *ScheduleEnd = p + ss.length;
+  p += sizeof(ss);
+  const char *s = GetString(p, ScheduleEnd);
+  if (!s)
+     return false;
+  tChannelID ChannelID = tChannelID::FromString(s);
+  if (!ChannelID.Valid()) {
+     esyslog("ERROR: invalid channel ID in EPG snapshot: %s", s);
+     return false;
+     }
+  cSchedule *Schedule = Schedules->AddSchedule(ChannelID);
+  for (uint32_t i = 0; i < ss.numEvents; i++) {
+      tEpgSnapshotEvent se;
+      if (ScheduleEnd - p < int(sizeof(se)))
+         return false;
+      memcpy(&se, p, sizeof(se));
+      p += sizeof(se);
+      const char *Title = GetString(p, ScheduleEnd);
+      const char *ShortText = Title ? GetString(p, ScheduleEnd) : NULL;
+      const char *Description = ShortText ? GetString(p, ScheduleEnd) : NULL;
+      if (!Description)
+         return false;
+      cComponents *Components = se.numComponents ? new cComponents : NULL;
+      for (int c = 0; c < se.numComponents; c++) {
+          if (const char *Component = GetString(p, ScheduleEnd))
+             Components->SetComponent(c, Component);
+          else {
+             delete Components;
+             return false;
+             }
+          }
+      if (se.startTime + se.duration + Setup.EPGLinger * 60 < Now || Schedule->GetEvent(se.eventID, se.startTime)) {
+         delete Components;
+         continue; // this event is outdated or already known
+         }
+      cEvent *Event = new cEvent(se.eventID);
+      Event->seen = 0;
+      Event->SetTableID(se.tableID);
+      Event->SetVersion(se.version);
+      Event->SetStartTime(se.startTime);
+      Event->SetDuration(se.duration);
+      Event->SetVps(se.vps);
+      Event->SetParentalRating(se.parentalRating);
+      memcpy(Event->contents, se.contents, sizeof(Event->contents));
+      Event->SetTitle(*Title ? Title : NULL);
+      Event->SetShortText(*ShortText ? ShortText : NULL);
+      if (*Description)
+         Event->description = (char *)Description; // used right from the mapped file
+      Event->components = Components;
+      Schedule->AddEvent(Event);
+      }
+  Schedule->Sort();
+  entries.Add(new cEpgSnapshotEntry(ChannelID, Offset, ss.length, Schedule->Events()->Count(), Now));
+  p = ScheduleEnd;
+  return true;
+}
+
+bool cEpgSnapshot::Read(cSchedules *Schedules, const char *FileName)
+{
+  if (data)
+     return false; // the snapshot can only be read once
+  int f = open(FileName, O_RDONLY);
+  if (f < 0) {
+     LOG_ERROR_STR(FileName);
+     return false;
+     }
+  struct stat st;
+  bool Result = false;
+  if (fstat(f, &st) == 0 && size_t(st.st_size) >= sizeof(tEpgSnapshotHeader)) {
+     // The mapping is private and writable, because cEvent::Dump() temporarily
+     // modifies the description in place:
+     void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, f, 0);
+     if (p != MAP_FAILED) {
+        tEpgSnapshotHeader sh;
+        memcpy(&sh, p, sizeof(sh));
+        if (memcmp(sh.magic, EPGSNAPSHOTMAGIC, sizeof(sh.magic)) == 0 && sh.version == EPGSNAPSHOTVERSION && sh.byteOrder == EPGSNAPSHOTBYTEORDER) {
+           data = (char *)p;
+           size = st.st_size;
+           time_t Now = time(NULL);
+           const char *d = data + sizeof(sh);
+           const char *End = data + size;
+           Result = true;
+           while (d < End) {
+                 if (!ReadSchedule(Schedules, d, End, d - data, Now)) {
+                    esyslog("ERROR: EPG snapshot '%s' is broken at offset %d", FileName, int(d - data));
+                    Result = false;
+                    break;
+                    }
+                 }
+           if (!Result)
+              entries.Clear();
+           // The mapping is kept even in case of an error, since events may already point into it.
+           }
+        else {
+           isyslog("EPG snapshot '%s' has an unknown format - ignored", FileName);
+           munmap(p, st.st_size);
+           }
+        }
+     else
+        LOG_ERROR_STR(FileName);
+     }
+  close(f);
+  return Result;
+}
+
+bool cEpgSnapshot::WriteString(FILE *f, const char *s)
+{
+  if (!s)
+     s = "";
+  return fwrite(s, strlen(s) + 1, 1, f) == 1;
+}
+
+bool cEpgSnapshot::WriteSchedule(FILE *f, const cSchedule *Schedule, time_t Now)
+{
+  long Start = ftell(f);
+  tEpgSnapshotSchedule ss = { 0, 0 };
+  if (fwrite(&ss, sizeof(ss), 1, f) != 1 || !WriteString(f, Schedule->ChannelID().ToString()))
+     return false;
+  for (const cEvent *Event = Schedule->Events()->First(); Event; Event = Schedule->Events()->Next(Event)) {
+      if (Event->EndTime() + Setup.EPGLinger * 60 < Now)
+         continue; // same as in cEvent::Dump()
+      tEpgSnapshotEvent se;
+      memset(&se, 0, sizeof(se));
+      se.startTime = Event->startTime;
+      se.vps = Event->vps;
+      se.eventID = Event->eventID;
+      se.duration = Event->duration;
+      se.numComponents = Event->components ? Event->components->NumComponents() : 0;
+      se.tableID = Event->tableID;
+      se.version = Event->version;
+      se.parentalRating = Event->parentalRating;
+      memcpy(se.contents, Event->contents, sizeof(se.contents));
+      if (fwrite(&se, sizeof(se), 1, f) != 1 || !WriteString(f, Event->title) || !WriteString(f, Event->shortText) || !WriteString(f, Event->description))
+         return false;
+      for (int i = 0; i < se.numComponents; i++) {
+          if (!WriteString(f, Event->components->Component(i)->ToString()))
+             return false;
+          }
+      ss.numEvents++;
+      }
+  long End = ftell(f);
+  ss.length = End - Start;
+  return fseek(f, Start, SEEK_SET) == 0 && fwrite(&ss, sizeof(ss), 1, f) == 1 && fseek(f, End, SEEK_SET) == 0;
+}
+
+bool cEpgSnapshot::Write(const char *FileName)
+{
+  // Map the previous snapshot to copy the data of unchanged schedules from it:
+  char *Old = NULL;
+  size_t OldSize = 0;
+  if (!invalid && entries.Count()) {
+     int f = open(FileName, O_RDONLY);
+     if (f >= 0) {
+        struct stat st;
+        if (fstat(f, &st) == 0 && st.st_size > 0) {
+           void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, f, 0);
+           if (p != MAP_FAILED) {
+              Old = (char *)p;
+              OldSize = st.st_size;
+              }
+           }
+        close(f);
+        }
+     }
+  invalid = false;
+  cList<cEpgSnapshotEntry> NewEntries;
+  int Copied = 0;
+  int Written = 0;
+  bool Result = false;
+  cSafeFile f(FileName);
+  if (f.Open()) {
+     time_t Now = time(NULL);
+     tEpgSnapshotHeader sh;
+     memcpy(sh.magic, EPGSNAPSHOTMAGIC, sizeof(sh.magic));
+     sh.version = EPGSNAPSHOTVERSION;
+     sh.byteOrder = EPGSNAPSHOTBYTEORDER;
+     Result = fwrite(&sh, sizeof(sh), 1, f) == 1;
+     // The schedules are only locked while one of them is being written, so
+     // that EPG data can be stored in the meantime (see cSchedules::Dump()):
+     for (const cSchedule *Schedule = NULL; Result; ) {
+         cSchedulesLock SchedulesLock;
+         const cSchedules *Schedules = cSchedules::Schedules(SchedulesLock);
+         if (!Schedules || !(Schedule = Schedule ? Schedules->Next(Schedule) : Schedules->First()))
+            break;
+         if (!Channels.GetByChannelID(Schedule->ChannelID(), true))
+            continue; // same as in cSchedule::Dump()
+         off_t Offset = ftell(f);
+         int NumEvents = Schedule->Events()->Count();
+         cEpgSnapshotEntry *e = GetEntry(Schedule->ChannelID());
+         if (Old && e && Schedule->Modified() < e->written && NumEvents == e->numEvents && e->offset + e->length <= off_t(OldSize)) {
+            Result = fwrite(Old + e->offset, e->length, 1, f) == 1;
+            NewEntries.Add(new cEpgSnapshotEntry(e->channelID, Offset, e->length, NumEvents, e->written));
+            Copied++;
+            }
+         else {
+            Result = WriteSchedule(f, Schedule, Now);
+            NewEntries.Add(new cEpgSnapshotEntry(Schedule->ChannelID(), Offset, ftell(f) - Offset, NumEvents, Now));
+            Written++;
+            }
+         }
+     if (!f.Close())
+        Result = false;
+     }
+  if (Old)
+     munmap(Old, OldSize);
+  entries.Clear();
+  if (Result) {
+     while (cEpgSnapshotEntry *e = NewEntries.First()) {
+           NewEntries.Del(e, false);
+           entries.Add(e);
+           }
+     dsyslog("wrote EPG snapshot %s (%d schedules written, %d copied)", FileName, Written, Copied);
+     }
+  return Result;
+}
+
 // --- cEvent ----------------------------------------------------------------
 
+#define EVENTSLABSIZE 1024 // number of cEvent objects that are allocated at once
+
+// Since there are typically hundreds of thousands of events, they are allocated
+// from larger blocks, which are never given back, but are reused for new events.
+
+static cMutex EventSlabMutex;
+static void *EventFreeList = NULL;
+
+void *cEvent::operator new(size_t Size)
+{
+  if (Size != sizeof(cEvent))
+     return ::operator new(Size); // derived class
+  cMutexLock MutexLock(&EventSlabMutex);
+  if (!EventFreeList) {
+     char *Slab = (char *)::operator new(EVENTSLABSIZE * sizeof(cEvent));
+     for (int i = EVENTSLABSIZE; i-- > 0; ) {
+         void *p = Slab + i * sizeof(cEvent);
+         *(void **)p = EventFreeList;
+         EventFreeList = p;
+         }
+     }
+  void *p = EventFreeList;
+  EventFreeList = *(void **)p;
+  return p;
+}
+
+void cEvent::operator delete(void *Ptr, size_t Size)
+{
+  if (!Ptr)
+     return;
+  if (Size != sizeof(cEvent)) {
+     ::operator delete(Ptr);
+     return;
+     }
+  cMutexLock MutexLock(&EventSlabMutex);
+  *(void **)Ptr = EventFreeList;
+  EventFreeList = Ptr;
+}
+
 cEvent::cEvent(tEventID EventID)
 {
   schedule = NULL;
@@ -123,18 +1090,22 @@ cEvent::cEvent(tEventID EventID)
   description = NULL;
   components = NULL;
   memset(contents, 0, sizeof(contents));
+  parsed = 0;
   parentalRating = 0;
   startTime = 0;
   duration = 0;
+  indexSlot = -1;
   vps = 0;
   SetSeen();
 }
 
 cEvent::~cEvent()
 {
-  free(title);
-  free(shortText);
-  free(description);
+  EpgIndex.Del(this);
+  StringPool.Put(title);
+  StringPool.Put(shortText);
+  if (!cEpgSnapshot::Contains(description))
+     free(description);
   delete components;
 }
 
@@ -179,16 +1150,30 @@ void cEvent::SetRunningStatus(int RunningStatus, cChannel *Channel)
 
 void cEvent::SetTitle(const char *Title)
 {
-  title = strcpyrealloc(title, Title);
+  if (Title != title) {
+     if (indexSlot >= 0 && strcmp(Title ? Title : "", title ? title : "") != 0)
+        EpgIndex.Del(this); // will be indexed again when the schedule is sorted
+     StringPool.Put(title);
+     title = StringPool.Get(Title);
+     }
 }
 
 void cEvent::SetShortText(const char *ShortText)
 {
-  shortText = strcpyrealloc(shortText, ShortText);
+  if (ShortText != shortText) {
+     if (indexSlot >= 0 && strcmp(ShortText ? ShortText : "", shortText ? shortText : "") != 0)
+        EpgIndex.Del(this);
+     StringPool.Put(shortText);
+     shortText = StringPool.Get(ShortText);
+     }
 }
 
 void cEvent::SetDescription(const char *Description)
 {
+  if (indexSlot >= 0 && strcmp(Description ? Description : "", description ? description : "") != 0)
+     EpgIndex.Del(this);
+  if (cEpgSnapshot::Contains(description))
+     description = NULL; // not allocated, so it must not be realloc'ed
   description = strcpyrealloc(description, Description);
 }
 
@@ -215,14 +1200,18 @@ void cEvent::SetStartTime(time_t StartTime)
      if (schedule)
         schedule->UnhashEvent(this);
      startTime = StartTime;
-     if (schedule)
+     if (schedule) {
         schedule->HashEvent(this);
+        schedule->sorted = false;
+        }
      }
 }
 
 void cEvent::SetDuration(int Duration)
 {
   duration = Duration;
+  if (schedule && duration > schedule->maxDuration)
+     schedule->maxDuration = duration;
 }
 
 void cEvent::SetVps(time_t Vps)
@@ -463,18 +1452,30 @@ void cEvent::Dump(FILE *f, const char *Prefix, bool InfoOnly) const
      }
 }
 
+// The fields that have been set by cEvent::Parse():
+#define EPF_TITLE       0x01
+#define EPF_SHORTTEXT   0x02
+#define EPF_DESCRIPTION 0x04
+#define EPF_CONTENTS    0x08
+#define EPF_RATING      0x10
+#define EPF_VPS         0x20
+
 bool cEvent::Parse(char *s)
 {
   char *t = skipspace(s + 1);
   switch (*s) {
     case 'T': SetTitle(t);
+              parsed |= EPF_TITLE;
               break;
     case 'S': SetShortText(t);
+              parsed |= EPF_SHORTTEXT;
               break;
     case 'D': strreplace(t, '|', '\n');
               SetDescription(t);
+              parsed |= EPF_DESCRIPTION;
               break;
     case 'G': {
+                parsed |= EPF_CONTENTS;
                 memset(contents, 0, sizeof(contents));
                 for (int i = 0; i < MaxEventContents; i++) {
                     char *tail = NULL;
@@ -489,12 +1490,14 @@ bool cEvent::Parse(char *s)
               }
               break;
     case 'R': SetParentalRating(atoi(t));
+              parsed |= EPF_RATING;
               break;
     case 'X': if (!components)
                  components = new cComponents;
               components->SetComponent(components->NumComponents(), t);
               break;
     case 'V': SetVps(atoi(t));
+              parsed |= EPF_VPS;
               break;
     default:  esyslog("ERROR: unexpected tag while reading EPG data: %s", s);
               return false;
@@ -663,6 +1666,14 @@ static void StripControlCharacters(char *s)
 
 void cEvent::FixEpgBugs(void)
 {
+  // The title and short text are shared with other events, and the description
+  // may still be in the EPG snapshot, so we work on private copies. The texts
+  // will be indexed again when the schedule is sorted:
+  EpgIndex.Del(this);
+  title = StringPool.Private(title);
+  shortText = StringPool.Private(shortText);
+  if (cEpgSnapshot::Contains(description))
+     description = strdup(description);
   if (isempty(title)) {
      // we don't want any "(null)" titles
      title = strcpyrealloc(title, tr("No title"));
@@ -874,6 +1885,13 @@ Final:
   StripControlCharacters(title);
   StripControlCharacters(shortText);
   StripControlCharacters(description);
+  // Put the private copies back into the pool:
+  char *p = title;
+  title = StringPool.Get(p);
+  free(p);
+  p = shortText;
+  shortText = StringPool.Get(p);
+  free(p);
 }
 
 // --- cSchedule -------------------------------------------------------------
@@ -881,9 +1899,57 @@ Final:
 cSchedule::cSchedule(tChannelID ChannelID)
 {
   channelID = ChannelID;
+  sorted = true;
+  maxDuration = 0;
+  searchable = true;
   hasRunning = false;
   modified = 0;
   presentSeen = 0;
+  changes = 0;
+}
+
+void cSchedule::IndexEvents(void)
+{
+  // Must only be called while the events are sorted by their start times!
+  eventsSorted.Clear();
+  maxDuration = 0;
+  for (cEvent *p = events.First(); p; p = events.Next(p)) {
+      eventsSorted.Append(p);
+      if (p->Duration() > maxDuration)
+         maxDuration = p->Duration();
+      if (p->indexSlot < 0 && searchable)
+         EpgIndex.Add(p); // its texts have changed
+      }
+  sorted = true;
+  changes++;
+}
+
+void cSchedule::FixRunningStatus(void)
+{
+  // Make sure there are no RunningStatusUndefined before the currently running event:
+  if (hasRunning) {
+     for (cEvent *p = events.First(); p; p = events.Next(p)) {
+         if (p->RunningStatus() >= SI::RunningStatusPausing)
+            break;
+         p->SetRunningStatus(SI::RunningStatusNotRunning);
+         }
+     }
+}
+
+int cSchedule::FindEvent(time_t Time) const
+{
+  // Returns the index of the first event in eventsSorted that starts at or after
+  // the given Time (or eventsSorted.Size() if there is no such event):
+  int Lo = 0;
+  int Hi = eventsSorted.Size();
+  while (Lo < Hi) {
+        int Mid = (Lo + Hi) / 2;
+        if (eventsSorted[Mid]->StartTime() < Time)
+           Lo = Mid + 1;
+        else
+           Hi = Mid;
+        }
+  return Lo;
 }
 
 cEvent *cSchedule::AddEvent(cEvent *Event)
@@ -891,6 +1957,21 @@ cEvent *cSchedule::AddEvent(cEvent *Event)
   events.Add(Event);
   Event->schedule = this;
   HashEvent(Event);
+  changes++;
+  if (searchable)
+     EpgIndex.Add(Event);
+  if (sorted) {
+     // Events are typically added in the order of their start times, in which
+     // case the index can simply be extended:
+     int n = eventsSorted.Size();
+     if (n == 0 || eventsSorted[n - 1]->StartTime() <= Event->StartTime()) {
+        eventsSorted.Append(Event);
+        if (Event->Duration() > maxDuration)
+           maxDuration = Event->Duration();
+        }
+     else
+        sorted = false;
+     }
   return Event;
 }
 
@@ -900,7 +1981,16 @@ void cSchedule::DelEvent(cEvent *Event)
      if (hasRunning && Event->IsRunning())
         ClrRunningStatus();
      UnhashEvent(Event);
+     if (sorted) {
+        for (int i = FindEvent(Event->StartTime()); i < eventsSorted.Size(); i++) {
+            if (eventsSorted[i] == Event) {
+               eventsSorted.Remove(i);
+               break;
+               }
+            }
+        }
      events.Del(Event);
+     changes++;
      }
 }
 
@@ -909,6 +1999,7 @@ void cSchedule::HashEvent(cEvent *Event)
   eventsHashID.Add(Event, Event->EventID());
   if (Event->StartTime() > 0) // 'StartTime < 0' is apparently used with NVOD channels
      eventsHashStartTime.Add(Event, Event->StartTime());
+  changes++;
 }
 
 void cSchedule::UnhashEvent(cEvent *Event)
@@ -916,12 +2007,28 @@ void cSchedule::UnhashEvent(cEvent *Event)
   eventsHashID.Del(Event, Event->EventID());
   if (Event->StartTime() > 0) // 'StartTime < 0' is apparently used with NVOD channels
      eventsHashStartTime.Del(Event, Event->StartTime());
+  changes++;
 }
 
 const cEvent *cSchedule::GetPresentEvent(void) const
 {
   const cEvent *pe = NULL;
   time_t now = time(NULL);
+  if (sorted) {
+     int n = FindEvent(now + 1);
+     if (n > 0)
+        pe = eventsSorted[n - 1];
+     // A running event takes precedence. Only events that may still be running
+     // (allowing for some overrun) need to be checked:
+     for (int i = FindEvent(now - maxDuration - RUNNINGSTATUSOVERRUN); i < eventsSorted.Size(); i++) {
+         const cEvent *p = eventsSorted[i];
+         if (p->StartTime() > now + 3600)
+            break;
+         if (p->SeenWithin(RUNNINGSTATUSTIMEOUT) && p->RunningStatus() >= SI::RunningStatusPausing)
+            return p;
+         }
+     return pe;
+     }
   for (cEvent *p = events.First(); p; p = events.Next(p)) {
       if (p->StartTime() <= now)
          pe = p;
@@ -938,6 +2045,10 @@ const cEvent *cSchedule::GetFollowingEvent(void) const
   const cEvent *p = GetPresentEvent();
   if (p)
      p = events.Next(p);
+  else if (sorted) {
+     int i = FindEvent(time(NULL));
+     p = i < eventsSorted.Size() ? eventsSorted[i] : NULL;
+     }
   else {
      time_t now = time(NULL);
      for (p = events.First(); p; p = events.Next(p)) {
@@ -962,6 +2073,20 @@ const cEvent *cSchedule::GetEventAround(time_t Time) const
 {
   const cEvent *pe = NULL;
   time_t delta = INT_MAX;
+  if (sorted) {
+     // Only events that start within the longest duration before Time can be around it:
+     for (int i = FindEvent(Time - maxDuration); i < eventsSorted.Size(); i++) {
+         const cEvent *p = eventsSorted[i];
+         time_t dt = Time - p->StartTime();
+         if (dt < 0)
+            break;
+         if (dt < delta && p->EndTime() >= Time) {
+            delta = dt;
+            pe = p;
+            }
+         }
+     return pe;
+     }
   for (cEvent *p = events.First(); p; p = events.Next(p)) {
       time_t dt = Time - p->StartTime();
       if (dt >= 0 && dt < delta && p->EndTime() >= Time) {
@@ -972,6 +2097,15 @@ const cEvent *cSchedule::GetEventAround(time_t Time) const
   return pe;
 }
 
+const cEvent *cSchedule::GetEventFrom(time_t Time) const
+{
+  if (sorted) {
+     int i = FindEvent(Time - maxDuration);
+     return i < eventsSorted.Size() ? eventsSorted[i] : NULL;
+     }
+  return events.First();
+}
+
 void cSchedule::SetRunningStatus(cEvent *Event, int RunningStatus, cChannel *Channel)
 {
   hasRunning = false;
@@ -1011,14 +2145,8 @@ void cSchedule::ResetVersions(void)
 void cSchedule::Sort(void)
 {
   events.Sort();
-  // Make sure there are no RunningStatusUndefined before the currently running event:
-  if (hasRunning) {
-     for (cEvent *p = events.First(); p; p = events.Next(p)) {
-         if (p->RunningStatus() >= SI::RunningStatusPausing)
-            break;
-         p->SetRunningStatus(SI::RunningStatusNotRunning);
-         }
-     }
+  IndexEvents();
+  FixRunningStatus();
 }
 
 void cSchedule::DropOutdated(time_t SegmentStart, time_t SegmentEnd, uchar TableID, uchar Version)
@@ -1039,6 +2167,7 @@ void cSchedule::DropOutdated(time_t SegmentStart, time_t SegmentEnd, uchar Table
                   UnhashEvent(p);
                   p->eventID = 0;
                   p->startTime = 0;
+                  sorted = false;
                   }
                }
             else
@@ -1172,8 +2301,12 @@ void cEpgDataWriter::Perform(void)
            p->Cleanup(now);
        }
   }
-  if (dump)
+  if (dump) {
+     // The text file is written before the snapshot, so that the snapshot
+     // is never older than the text file:
      cSchedules::Dump();
+     cSchedules::WriteSnapshot();
+     }
 }
 
 static cEpgDataWriter EpgDataWriter;
@@ -1195,6 +2328,7 @@ cSchedulesLock::~cSchedulesLock()
 
 cSchedules cSchedules::schedules;
 char *cSchedules::epgDataFileName = NULL;
+char *cSchedules::epgSnapshotFileName = NULL;
 time_t cSchedules::lastDump = time(NULL);
 time_t cSchedules::modified = 0;
 
@@ -1207,6 +2341,16 @@ void cSchedules::SetEpgDataFileName(const char *FileName)
 {
   free(epgDataFileName);
   epgDataFileName = FileName ? strdup(FileName) : NULL;
+  free(epgSnapshotFileName);
+  epgSnapshotFileName = NULL;
+  if (FileName) {
+     // "epg.data" becomes "epg.bin":
+     const char *p = strrchr(FileName, '.');
+     if (p && strcmp(p, ".data") == 0)
+        epgSnapshotFileName = strdup(cString::sprintf("%.*s.bin", int(p - FileName), FileName));
+     else
+        epgSnapshotFileName = strdup(cString::sprintf("%s.bin", FileName));
+     }
   EpgDataWriter.SetDump(epgDataFileName != NULL);
 }
 
@@ -1237,6 +2381,7 @@ void cSchedules::ResetVersions(void)
   if (s) {
      for (cSchedule *Schedule = s->First(); Schedule; Schedule = s->Next(Schedule))
          Schedule->ResetVersions();
+     cEpgSnapshot::Invalidate();
      }
 }
 
@@ -1249,6 +2394,7 @@ bool cSchedules::ClearAll(void)
          Timer->SetEvent(NULL);
      for (cSchedule *Schedule = s->First(); Schedule; Schedule = s->Next(Schedule))
          Schedule->Cleanup(INT_MAX);
+     cEpgSnapshot::Invalidate();
      return true;
      }
   return false;
@@ -1256,29 +2402,44 @@ bool cSchedules::ClearAll(void)
 
 bool cSchedules::Dump(FILE *f, const char *Prefix, eDumpMode DumpMode, time_t AtTime)
 {
-  cSchedulesLock SchedulesLock;
-  cSchedules *s = (cSchedules *)Schedules(SchedulesLock);
-  if (s) {
-     cSafeFile *sf = NULL;
-     if (!f) {
-        sf = new cSafeFile(epgDataFileName);
-        if (sf->Open())
-           f = *sf;
-        else {
-           LOG_ERROR;
-           delete sf;
-           return false;
-           }
-        }
-     for (cSchedule *p = s->First(); p; p = s->Next(p))
-         p->Dump(f, Prefix, DumpMode, AtTime);
-     if (sf) {
-        sf->Close();
+  cSafeFile *sf = NULL;
+  if (!f) {
+     sf = new cSafeFile(epgDataFileName);
+     if (sf->Open())
+        f = *sf;
+     else {
+        LOG_ERROR;
         delete sf;
+        return false;
         }
-     return true;
      }
-  return false;
+  // Writing all EPG data may take a while, so the schedules are only locked
+  // while one of them is being dumped. This way incoming EPG data doesn't have
+  // to wait for the whole dump. Schedules are never deleted, so it's safe to
+  // continue with the next one after locking again:
+  bool Result = true;
+  for (const cSchedule *p = NULL; ; ) {
+      cSchedulesLock SchedulesLock;
+      const cSchedules *s = Schedules(SchedulesLock);
+      if (!s) {
+         Result = false;
+         break;
+         }
+      if (!(p = p ? s->Next(p) : s->First()))
+         break;
+      p->Dump(f, Prefix, DumpMode, AtTime);
+      }
+  if (sf) {
+     if (!sf->Close())
+        Result = false;
+     delete sf;
+     }
+  return Result;
+}
+
+bool cSchedules::WriteSnapshot(void)
+{
+  return epgSnapshotFileName && cEpgSnapshot::Write(epgSnapshotFileName);
 }
 
 bool cSchedules::Read(FILE *f)
@@ -1287,7 +2448,20 @@ bool cSchedules::Read(FILE *f)
   cSchedules *s = (cSchedules *)Schedules(SchedulesLock);
   if (s) {
      bool OwnFile = f == NULL;
+     cTimeMs Timer;
      if (OwnFile) {
+        // Use the snapshot, unless the text file has been written after it:
+        time_t SnapshotTime = epgSnapshotFileName ? LastModifiedTime(epgSnapshotFileName) : 0;
+        if (SnapshotTime > 0 && (!epgDataFileName || SnapshotTime >= LastModifiedTime(epgDataFileName))) {
+           dsyslog("reading EPG data from %s", epgSnapshotFileName);
+           if (cEpgSnapshot::Read(s, epgSnapshotFileName)) {
+              modified = time(NULL);
+              for (cChannel *Channel = Channels.First(); Channel; Channel = Channels.Next(Channel))
+                  s->GetSchedule(Channel);
+              dsyslog("read EPG data in %d ms", int(Timer.Elapsed()));
+              return true;
+              }
+           }
         if (epgDataFileName && access(epgDataFileName, R_OK) == 0) {
            dsyslog("reading EPG data from %s", epgDataFileName);
            if ((f = fopen(epgDataFileName, "r")) == NULL) {
@@ -1299,8 +2473,10 @@ bool cSchedules::Read(FILE *f)
            return false;
         }
      bool result = cSchedule::Read(f, s);
-     if (OwnFile)
+     if (OwnFile) {
         fclose(f);
+        dsyslog("read EPG data in %d ms", int(Timer.Elapsed()));
+        }
      if (result) {
         // Initialize the channels' schedule pointers, so that the first WhatsOn menu will come up faster:
         for (cChannel *Channel = Channels.First(); Channel; Channel = Channels.Next(Channel))
@@ -1352,6 +2528,328 @@ const cSchedule *cSchedules::GetSchedule(const cChannel *Channel, bool AddIfMiss
   return Channel->schedule != &DummySchedule? Channel->schedule : NULL;
 }
 
+int cSchedules::Search(const cEpgQuery &Query, cVector<const cEvent *> &Events, int MaxEvents) const
+{
+  cVector<const cEvent *> Found;
+  if (EpgIndex.Search(Query, Found)) {
+     Found.Sort(CompareEventsByStartTime);
+     if (MaxEvents <= 0 || MaxEvents > Found.Size())
+        MaxEvents = Found.Size();
+     for (int i = 0; i < MaxEvents; i++)
+         Events.Append(Found[i]);
+     return MaxEvents;
+     }
+  return 0;
+}
+
+// --- cEpgBatch -------------------------------------------------------------
+
+#define EPGBATCHLOCKTIMEOUT 1000 // ms to wait for the write lock on the schedules
+
+cSchedule *cEpgBatch::GetSchedule(tChannelID ChannelID)
+{
+  ChannelID.ClrRid();
+  for (cSchedule *p = schedules.First(); p; p = schedules.Next(p)) {
+      if (p->ChannelID() == ChannelID)
+         return p;
+      }
+  cSchedule *p = new cSchedule(ChannelID);
+  p->searchable = false; // the index may only be modified while the schedules are locked
+  schedules.Add(p);
+  return p;
+}
+
+cEvent *cEpgBatch::AddEvent(tChannelID ChannelID, cEvent *Event)
+{
+  return GetSchedule(ChannelID)->AddEvent(Event);
+}
+
+bool cEpgBatch::Read(FILE *f)
+{
+  cReadLine ReadLine;
+  char *s;
+  while ((s = ReadLine.Read(f)) != NULL) {
+        if (*s == 'C') {
+           s = skipspace(s + 1);
+           char *p = strchr(s, ' ');
+           if (p)
+              *p = 0; // strips optional channel name
+           if (*s) {
+              tChannelID channelID = tChannelID::FromString(s);
+              if (channelID.Valid()) {
+                 if (!cEvent::Read(f, GetSchedule(channelID)))
+                    return false;
+                 }
+              else {
+                 esyslog("ERROR: invalid channel ID: %s", s);
+                 return false;
+                 }
+              }
+           }
+        else {
+           esyslog("ERROR: unexpected tag while reading EPG data: %s", s);
+           return false;
+           }
+        }
+  return true;
+}
+
+void cEpgBatch::SwapText(cEvent *Event, char *&Text, char *&From)
+{
+  if (Event->indexSlot >= 0 && strcmp(Text ? Text : "", From ? From : "") != 0)
+     EpgIndex.Del(Event); // will be indexed again at the end of the import
+  char *t = Text;
+  Text = From;
+  From = t;
+}
+
+void cEpgBatch::UpdateEvent(cEvent *Event, cEvent *From)
+{
+  // Same as cEvent::Read() does with an existing event: the data from the 'E'
+  // line and the components are always taken over, all other fields only if
+  // their lines have actually been given. The texts and components are exchanged
+  // rather than copied, so the old ones are deleted together with From:
+  Event->SetTableID(From->TableID());
+  Event->SetDuration(From->Duration());
+  cComponents *Components = Event->components;
+  Event->components = From->components;
+  From->components = Components;
+  if ((From->parsed & EPF_TITLE) || !Event->Title())
+     SwapText(Event, Event->title, From->title);
+  if (From->parsed & EPF_SHORTTEXT)
+     SwapText(Event, Event->shortText, From->shortText);
+  if (From->parsed & EPF_DESCRIPTION)
+     SwapText(Event, Event->description, From->description);
+  if (From->parsed & EPF_CONTENTS)
+     Event->SetContents(From->contents);
+  if (From->parsed & EPF_RATING)
+     Event->SetParentalRating(From->ParentalRating());
+  if (From->parsed & EPF_VPS)
+     Event->SetVps(From->Vps());
+}
+
+// The result of merging the events of a batch into a schedule, as prepared by
+// cEpgBatch::Prepare() while the schedules are only read locked:
+
+class cEpgBatchMerge : public cListObject {
+public:
+  cSchedule *batch;
+  cSchedule *schedule;
+  int changes;                // schedule->changes at the time this merge was prepared
+  cVector<cEvent *> events;   // all events of the merged schedule, in the order of their start times
+  cVector<cEvent *> updates;  // pairs of existing events and the batch events to update them from
+  cVector<cEvent *> outdated; // existing events that are to be phased out
+  cHash<cEvent> hashID;
+  cHash<cEvent> hashStartTime;
+  int maxDuration;
+  cEpgBatchMerge(cSchedule *Batch) { batch = Batch; schedule = NULL; changes = 0; maxDuration = 0; }
+  };
+
+static bool IsHashed(const cHash<cEvent> &Hash, const cEvent *Event, unsigned int Id)
+{
+  if (cList<cHashObject> *List = Hash.GetList(Id)) {
+     for (cHashObject *hob = List->First(); hob; hob = List->Next(hob)) {
+         if (hob->Object() == Event)
+            return true;
+         }
+     }
+  return false;
+}
+
+cEpgBatchMerge *cEpgBatch::Prepare(cSchedule *Batch, const cSchedules *Schedules, bool Replace)
+{
+  cEpgBatchMerge *Merge = new cEpgBatchMerge(Batch);
+  cVector<cEvent *> Events; // all events of the merged schedule except for the outdated ones
+  const cSchedule *s = Schedules->GetSchedule(Batch->ChannelID());
+  if (s) {
+     Merge->schedule = (cSchedule *)s;
+     Merge->changes = s->changes;
+     // Collect the existing events and hash them anew. Events that have already
+     // been phased out (see cSchedule::DropOutdated()) are no longer hashed:
+     time_t SegmentStart = Batch->events.First()->StartTime();
+     time_t SegmentEnd = Batch->events.Last()->EndTime();
+     for (cEvent *p = s->events.First(); p; p = s->events.Next(p)) {
+         if (!IsHashed(s->eventsHashID, p, p->EventID()))
+            Events.Append(p);
+         else if (Replace && p->EndTime() > SegmentStart && p->StartTime() > 0 && p->StartTime() < SegmentEnd && !Batch->GetEvent(p->EventID(), p->StartTime()))
+            Merge->outdated.Append(p);
+         else {
+            Events.Append(p);
+            Merge->hashID.Add(p, p->EventID());
+            if (p->StartTime() > 0) // 'StartTime < 0' is apparently used with NVOD channels
+               Merge->hashStartTime.Add(p, p->StartTime());
+            }
+         Merge->maxDuration = max(Merge->maxDuration, p->Duration());
+         }
+     }
+  // Pair the events of the batch with the existing ones (see cSchedule::GetEvent()):
+  for (cEvent *e = Batch->events.First(); e; ) {
+      cEvent *Next = Batch->events.Next(e);
+      cEvent *p = (cEvent *)(e->StartTime() > 0 ? Merge->hashStartTime.Get(e->StartTime()) : Merge->hashID.Get(e->EventID()));
+      if (!p) {
+         Events.Append(e);
+         Merge->hashID.Add(e, e->EventID());
+         if (e->StartTime() > 0)
+            Merge->hashStartTime.Add(e, e->StartTime());
+         }
+      else if (p->schedule == Batch) {
+         // The batch contains this event twice:
+         UpdateEvent(p, e);
+         Batch->DelEvent(e);
+         }
+      else {
+         Merge->updates.Append(p);
+         Merge->updates.Append(e);
+         }
+      Merge->maxDuration = max(Merge->maxDuration, e->Duration());
+      e = Next;
+      }
+  // The outdated events will have a start time of 0:
+  Events.Sort(CompareEventsByStartTime);
+  int i = 0;
+  while (i < Events.Size() && Events[i]->StartTime() <= 0)
+        Merge->events.Append(Events[i++]);
+  for (int j = 0; j < Merge->outdated.Size(); j++)
+      Merge->events.Append(Merge->outdated[j]);
+  while (i < Events.Size())
+        Merge->events.Append(Events[i++]);
+  return Merge;
+}
+
+void cEpgBatch::Commit(cEpgBatchMerge *Merge, cSchedule *Schedule)
+{
+  cSchedule *s = Schedule;
+  for (int i = 0; i < Merge->outdated.Size(); i++) {
+      cEvent *p = Merge->outdated[i];
+      if (s->hasRunning && p->IsRunning())
+         s->ClrRunningStatus();
+      p->eventID = 0;
+      p->startTime = 0;
+      }
+  for (int i = 0; i < Merge->updates.Size(); i += 2)
+      UpdateEvent(Merge->updates[i], Merge->updates[i + 1]);
+  s->eventsHashID.Swap(Merge->hashID);
+  s->eventsHashStartTime.Swap(Merge->hashStartTime);
+  s->eventsSorted.Clear();
+  for (int i = 0; i < Merge->events.Size(); i++) {
+      cEvent *p = Merge->events[i];
+      if (p->schedule == s)
+         s->events.Del(p, false);
+      else {
+         Merge->batch->events.Del(p, false);
+         p->schedule = s;
+         }
+      s->events.Add(p);
+      s->eventsSorted.Append(p);
+      }
+  s->maxDuration = Merge->maxDuration;
+  s->sorted = true;
+  s->changes++;
+  s->FixRunningStatus();
+}
+
+void cEpgBatch::Merge(cSchedule *Batch, cSchedule *Schedule, bool Replace)
+{
+  // Merges the events of the given Batch into the given Schedule the slow way,
+  // in case the schedule has been modified since the merge was prepared:
+  cSchedule *s = Schedule;
+  if (Replace) {
+     // Phase out (see cSchedule::DropOutdated()) all events within the time span
+     // of this batch that are not contained in it:
+     time_t SegmentStart = Batch->events.First()->StartTime();
+     time_t SegmentEnd = Batch->events.Last()->EndTime();
+     for (cEvent *p = s->events.First(); p; p = s->events.Next(p)) {
+         if (p->EndTime() > SegmentStart && p->StartTime() > 0 && p->StartTime() < SegmentEnd && !Batch->GetEvent(p->EventID(), p->StartTime())) {
+            if (s->hasRunning && p->IsRunning())
+               s->ClrRunningStatus();
+            s->UnhashEvent(p);
+            p->eventID = 0;
+            p->startTime = 0;
+            s->sorted = false;
+            }
+         }
+     }
+  for (cEvent *e = Batch->events.First(); e; ) {
+      cEvent *Next = Batch->events.Next(e);
+      if (cEvent *Event = (cEvent *)s->GetEvent(e->EventID(), e->StartTime()))
+         UpdateEvent(Event, e);
+      else {
+         Batch->events.Del(e, false);
+         s->AddEvent(e);
+         }
+      e = Next;
+      }
+  s->Sort();
+}
+
+bool cEpgBatch::Import(bool Replace)
+{
+  // Check and sort the events without holding any lock:
+  time_t Now = time(NULL);
+  int NumEvents = 0;
+  for (cSchedule *b = schedules.First(); b; b = schedules.Next(b)) {
+      for (cEvent *e = b->events.First(); e; ) {
+          cEvent *Next = b->events.Next(e);
+          if (!e->StartTime() || e->EndTime() + Setup.EPGLinger * 60 < Now)
+             b->DelEvent(e); // invalid or outdated
+          else if (!e->Title())
+             e->SetTitle(tr("No title"));
+          e = Next;
+          }
+      b->Sort();
+      NumEvents += b->events.Count();
+      }
+  // Prepare the merged schedules while only holding a read lock, so that
+  // readers are not blocked:
+  cList<cEpgBatchMerge> Merges;
+  {
+    cSchedulesLock SchedulesLock(false, EPGBATCHLOCKTIMEOUT);
+    const cSchedules *Schedules = cSchedules::Schedules(SchedulesLock);
+    if (!Schedules)
+       return false;
+    for (cSchedule *b = schedules.First(); b; b = schedules.Next(b)) {
+        if (b->events.First())
+           Merges.Add(Prepare(b, Schedules, Replace));
+        }
+  }
+  // Put the prepared events in place:
+  cTimeMs Timer;
+  {
+    cSchedulesLock SchedulesLock(true, EPGBATCHLOCKTIMEOUT);
+    cSchedules *Schedules = (cSchedules *)cSchedules::Schedules(SchedulesLock);
+    if (!Schedules)
+       return false;
+    for (cEpgBatchMerge *m = Merges.First(); m; m = Merges.Next(m)) {
+        cSchedule *s = Schedules->AddSchedule(m->batch->ChannelID());
+        if (s->changes == m->changes)
+           Commit(m, s);
+        else
+           Merge(m->batch, s, Replace);
+        m->schedule = s;
+        Schedules->SetModified(s);
+        }
+  }
+  int LockedMs = Timer.Elapsed();
+  // Add the new and changed events to the search index (which has its own lock):
+  {
+    cSchedulesLock SchedulesLock;
+    if (cSchedules::Schedules(SchedulesLock)) {
+       for (cEpgBatchMerge *m = Merges.First(); m; m = Merges.Next(m)) {
+           for (cEvent *p = m->schedule->events.First(); p; p = m->schedule->events.Next(p)) {
+               if (p->indexSlot < 0)
+                  EpgIndex.Add(p);
+               }
+           }
+       }
+  }
+  dsyslog("imported %d EPG events for %d channels (schedules write locked for %d ms)", NumEvents, schedules.Count(), LockedMs);
+  // Events that have only been used to update existing ones (and the texts
+  // they have been exchanged with) are deleted after the locks have been released:
+  Merges.Clear();
+  schedules.Clear();
+  return true;
+}
+
 // --- cEpgDataReader --------------------------------------------------------
 
 cEpgDataReader::cEpgDataReader(void)
@@ -70,6 +70,9 @@ typedef u_int32_t tEventID;
 
 class cEvent : public cListObject {
   friend class cSchedule;
+  friend class cEpgSnapshot;
+  friend class cEpgIndex;
+  friend class cEpgBatch;
 private:
   // The sequence of these parameters is optimized for minimal memory waste!
   cSchedule *schedule;     // The Schedule this event belongs to
@@ -83,13 +86,17 @@ private:
   char *description;       // Description of this event
   cComponents *components; // The stream components of this event
   uchar contents[MaxEventContents]; // Contents of this event
+  uchar parsed;            // The fields that have been set by Parse() (used by cEpgBatch)
   time_t startTime;        // Start time of this event
   int duration;            // Duration of this event in seconds
+  int indexSlot;           // The slot of this event in the EPG search index (-1 if not indexed)
   time_t vps;              // Video Programming Service timestamp (VPS, aka "Programme Identification Label", PIL)
   time_t seen;             // When this event was last seen in the data stream
 public:
   cEvent(tEventID EventID);
   ~cEvent();
+  static void *operator new(size_t Size);
+  static void operator delete(void *Ptr, size_t Size);
   virtual int Compare(const cListObject &ListObject) const;
   tChannelID ChannelID(void) const;
   const cSchedule *Schedule(void) const { return schedule; }
@@ -140,15 +147,55 @@ public:
 
 class cSchedules;
 
+class cEpgQuery {
+  friend class cEpgIndex;
+private:
+  cStringList words;
+  cStringList phrases;
+  tChannelID *channels;
+  int numChannels;
+  time_t from;
+  time_t to;
+  bool Matches(const cEvent *Event) const;
+public:
+  cEpgQuery(const char *Query = NULL);
+       ///< Creates a query for events that contain all the words in the given
+       ///< Query in their title, short text or description. Words are compared
+       ///< case insensitively, and a text in double quotes must appear as a phrase.
+  ~cEpgQuery();
+  void AddTerm(const char *Term);
+       ///< Adds a word that must appear in an event. If Term consists of several
+       ///< words, they are treated as a phrase.
+  void AddPhrase(const char *Phrase);
+       ///< Adds a sequence of words that must appear in an event in this order
+       ///< (ignoring any punctuation between them).
+  void AddChannel(tChannelID ChannelID);
+       ///< Restricts the query to events of the given channel(s). By default
+       ///< events of all channels are found.
+  void SetTime(time_t From, time_t To = 0);
+       ///< Restricts the query to events that haven't ended at From and start
+       ///< before To. A value of 0 means no restriction.
+  };
+
 class cSchedule : public cListObject  {
+  friend class cEvent;
+  friend class cEpgBatch;
 private:
   tChannelID channelID;
   cList<cEvent> events;
   cHash<cEvent> eventsHashID;
   cHash<cEvent> eventsHashStartTime;
+  cVector<cEvent *> eventsSorted; // the events in the order of their start times, valid if 'sorted' is true
+  bool sorted;
+  int maxDuration;
+  bool searchable; // false for the schedules of a cEpgBatch
   bool hasRunning;
   time_t modified;
   time_t presentSeen;
+  int changes; // incremented whenever events are added, deleted, rehashed or sorted
+  void IndexEvents(void);
+  void FixRunningStatus(void);
+  int FindEvent(time_t Time) const;
 public:
   cSchedule(tChannelID ChannelID);
   tChannelID ChannelID(void) const { return channelID; }
@@ -173,6 +220,12 @@ public:
   const cEvent *GetFollowingEvent(void) const;
   const cEvent *GetEvent(tEventID EventID, time_t StartTime = 0) const;
   const cEvent *GetEventAround(time_t Time) const;
+  const cEvent *GetEventFrom(time_t Time) const;
+       ///< Returns the first event in Events() that may end at or after the given
+       ///< Time. All events before the returned one have ended before Time, so
+       ///< a caller looking for events around Time can start iterating there instead
+       ///< of at the beginning of the list. Returns the first event if the schedule
+       ///< hasn't been sorted since the last change of an event's start time.
   void Dump(FILE *f, const char *Prefix = "", eDumpMode DumpMode = dmAll, time_t AtTime = 0) const;
   static bool Read(FILE *f, cSchedules *Schedules);
   };
@@ -193,6 +246,7 @@ private:
   cRwLock rwlock;
   static cSchedules schedules;
   static char *epgDataFileName;
+  static char *epgSnapshotFileName;
   static time_t lastDump;
   static time_t modified;
 public:
@@ -208,9 +262,54 @@ public:
   static bool ClearAll(void);
   static bool Dump(FILE *f = NULL, const char *Prefix = "", eDumpMode DumpMode = dmAll, time_t AtTime = 0);
   static bool Read(FILE *f = NULL);
+         ///< Reads EPG data from the given file. If f is NULL, the EPG snapshot is
+         ///< read, or the epg.data file if the snapshot doesn't exist or is older.
+  static bool WriteSnapshot(void);
+         ///< Writes the binary EPG snapshot, which is read at startup instead of
+         ///< the (much slower to parse) epg.data file.
   cSchedule *AddSchedule(tChannelID ChannelID);
   const cSchedule *GetSchedule(tChannelID ChannelID) const;
   const cSchedule *GetSchedule(const cChannel *Channel, bool AddIfMissing = false) const;
+  int Search(const cEpgQuery &Query, cVector<const cEvent *> &Events, int MaxEvents = 0) const;
+         ///< Searches for events matching the given Query and appends them to Events,
+         ///< sorted by their start times. If MaxEvents is given, only the first
+         ///< MaxEvents matching events are returned. Returns the number of events
+         ///< found. This uses an index of all words in the EPG data, so it is fast
+         ///< enough to be called while a menu is being displayed.
+  };
+
+class cEpgBatchMerge;
+
+class cEpgBatch {
+private:
+  cList<cSchedule> schedules;
+  cSchedule *GetSchedule(tChannelID ChannelID);
+  static void SwapText(cEvent *Event, char *&Text, char *&From);
+  static void UpdateEvent(cEvent *Event, cEvent *From);
+  static cEpgBatchMerge *Prepare(cSchedule *Batch, const cSchedules *Schedules, bool Replace);
+  static void Commit(cEpgBatchMerge *Merge, cSchedule *Schedule);
+  static void Merge(cSchedule *Batch, cSchedule *Schedule, bool Replace);
+public:
+  cEpgBatch(void) {}
+  cEvent *AddEvent(tChannelID ChannelID, cEvent *Event);
+       ///< Adds the given Event to the schedule of the given channel in this batch
+       ///< and returns it. The batch takes ownership of Event.
+  bool Read(FILE *f);
+       ///< Reads EPG data in the format of the epg.data file (as used by the SVDRP
+       ///< command PUTE) into this batch. This doesn't lock the schedules.
+  bool Import(bool Replace = false);
+       ///< Checks the events in this batch and stores them in the actual schedules.
+       ///< Events that already exist in a schedule are updated, just like
+       ///< cEvent::Read() does, i.e. only the fields that have actually been
+       ///< given in the data are changed. If Replace is true,
+       ///< any events of a schedule that fall within the time span of the events of
+       ///< that channel in this batch, but are not contained in this batch, are
+       ///< dropped. The merged schedules are prepared while holding only a read
+       ///< lock, and the schedules are then write locked just for putting the
+       ///< prepared events and hash tables in place (which takes time proportional
+       ///< to the number of events, but involves no sorting, hashing or indexing).
+       ///< Returns false if the schedules couldn't be locked, in which case the batch
+       ///< is left unchanged. Otherwise the batch is empty afterwards.
   };
 
 class cEpgDataReader : public cThread {
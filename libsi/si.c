@@ -14,6 +14,7 @@
 #include <errno.h>
 #include <iconv.h>
 #include <malloc.h>
+#include <new>
 #include <stdlib.h> // for broadcaster stupidity workaround
 #include <string.h>
 #include "descriptor.h"
@@ -109,6 +110,30 @@ DescriptorTag Descriptor::getDescriptorTag(const unsigned char *d) {
    return (DescriptorTag)((const DescriptorHeader*)d)->descriptor_tag;
 }
 
+void DescriptorBuffer::clear() {
+   if (descriptor) {
+      if (allocated)
+         delete descriptor;
+      else
+         descriptor->~Descriptor();
+      descriptor=0;
+      allocated=false;
+   }
+}
+
+void *DescriptorBuffer::allocate(unsigned int size) {
+   clear();
+   return size <= sizeof(storage) ? &storage : 0;
+}
+
+Descriptor *DescriptorBuffer::detach() {
+   if (!descriptor)
+      return 0;
+   Descriptor *d=Descriptor::getDescriptor(descriptor->getData(), domain, true);
+   d->CheckParse();
+   return d;
+}
+
 Descriptor *DescriptorLoop::getNext(Iterator &it) {
    if (isValid() && it.i<getLength()) {
       return createDescriptor(it.i, true);
@@ -116,6 +141,32 @@ Descriptor *DescriptorLoop::getNext(Iterator &it) {
    return 0;
 }
 
+Descriptor *DescriptorLoop::getNext(Iterator &it, DescriptorBuffer &buffer) {
+   if (isValid() && it.i<getLength()) {
+      return createDescriptor(it.i, true, &buffer);
+   }
+   return 0;
+}
+
+Descriptor *DescriptorLoop::getNext(Iterator &it, DescriptorTag tag, DescriptorBuffer &buffer) {
+   Descriptor *d=0;
+   int len;
+   if (isValid() && it.i<(len=getLength())) {
+      const unsigned char *p=data.getData(it.i);
+      const unsigned char *end=p+len-it.i;
+      while (p < end) {
+         if (Descriptor::getDescriptorTag(p) == tag) {
+            d=createDescriptor(it.i, false, &buffer);
+            if (d)
+               break;
+         }
+         it.i+=Descriptor::getLength(p);
+         p+=Descriptor::getLength(p);
+      }
+   }
+   return d;
+}
+
 Descriptor *DescriptorLoop::getNext(Iterator &it, DescriptorTag tag, bool returnUnimplemetedDescriptor) {
    Descriptor *d=0;
    int len;
@@ -156,10 +207,10 @@ Descriptor *DescriptorLoop::getNext(Iterator &it, DescriptorTag *tags, int array
    return d;
 }
 
-Descriptor *DescriptorLoop::createDescriptor(int &i, bool returnUnimplemetedDescriptor) {
+Descriptor *DescriptorLoop::createDescriptor(int &i, bool returnUnimplemetedDescriptor, DescriptorBuffer *buffer) {
    if (!checkSize(Descriptor::getLength(data.getData(i))))
       return 0;
-   Descriptor *d=Descriptor::getDescriptor(data+i, domain, returnUnimplemetedDescriptor);
+   Descriptor *d=Descriptor::getDescriptor(data+i, domain, returnUnimplemetedDescriptor, buffer);
    if (!d)
       return 0;
    i+=d->getLength();
@@ -505,140 +556,157 @@ void String::decodeText(char *buffer, char *shortVersion, int sizeBuffer, int si
    *shortVersion = '\0';
 }
 
-Descriptor *Descriptor::getDescriptor(CharArray da, DescriptorTagDomain domain, bool returnUnimplemetedDescriptor) {
+template <class T> Descriptor *Descriptor::create(DescriptorBuffer *buffer) {
+   if (buffer) {
+      T *d;
+      if (void *p=buffer->allocate(sizeof(T)))
+         d=new(p) T();
+      else {
+         d=new T();
+         buffer->allocated=true;
+      }
+      buffer->descriptor=d;
+      return d;
+   }
+   return new T();
+}
+
+Descriptor *Descriptor::getDescriptor(CharArray da, DescriptorTagDomain domain, bool returnUnimplemetedDescriptor, DescriptorBuffer *buffer) {
+   if (buffer)
+      buffer->domain=domain;
    Descriptor *d=0;
    switch (domain) {
    case SI:
       switch ((DescriptorTag)da.getData<DescriptorHeader>()->descriptor_tag) {
          case CaDescriptorTag:
-            d=new CaDescriptor();
+            d=create<CaDescriptor>(buffer);
             break;
          case CarouselIdentifierDescriptorTag:
-            d=new CarouselIdentifierDescriptor();
+            d=create<CarouselIdentifierDescriptor>(buffer);
             break;
          case AVCDescriptorTag:
-            d=new AVCDescriptor();
+            d=create<AVCDescriptor>(buffer);
             break;
          case NetworkNameDescriptorTag:
-            d=new NetworkNameDescriptor();
+            d=create<NetworkNameDescriptor>(buffer);
             break;
          case ServiceListDescriptorTag:
-            d=new ServiceListDescriptor();
+            d=create<ServiceListDescriptor>(buffer);
             break;
          case SatelliteDeliverySystemDescriptorTag:
-            d=new SatelliteDeliverySystemDescriptor();
+            d=create<SatelliteDeliverySystemDescriptor>(buffer);
             break;
          case CableDeliverySystemDescriptorTag:
-            d=new CableDeliverySystemDescriptor();
+            d=create<CableDeliverySystemDescriptor>(buffer);
             break;
          case TerrestrialDeliverySystemDescriptorTag:
-            d=new TerrestrialDeliverySystemDescriptor();
+            d=create<TerrestrialDeliverySystemDescriptor>(buffer);
             break;
          case BouquetNameDescriptorTag:
-            d=new BouquetNameDescriptor();
+            d=create<BouquetNameDescriptor>(buffer);
             break;
          case ServiceDescriptorTag:
-            d=new ServiceDescriptor();
+            d=create<ServiceDescriptor>(buffer);
             break;
          case NVODReferenceDescriptorTag:
-            d=new NVODReferenceDescriptor();
+            d=create<NVODReferenceDescriptor>(buffer);
             break;
          case TimeShiftedServiceDescriptorTag:
-            d=new TimeShiftedServiceDescriptor();
+            d=create<TimeShiftedServiceDescriptor>(buffer);
             break;
          case ComponentDescriptorTag:
-            d=new ComponentDescriptor();
+            d=create<ComponentDescriptor>(buffer);
             break;
          case StreamIdentifierDescriptorTag:
-            d=new StreamIdentifierDescriptor();
+            d=create<StreamIdentifierDescriptor>(buffer);
             break;
          case SubtitlingDescriptorTag:
-            d=new SubtitlingDescriptor();
+            d=create<SubtitlingDescriptor>(buffer);
             break;
          case MultilingualNetworkNameDescriptorTag:
-            d=new MultilingualNetworkNameDescriptor();
+            d=create<MultilingualNetworkNameDescriptor>(buffer);
             break;
          case MultilingualBouquetNameDescriptorTag:
-            d=new MultilingualBouquetNameDescriptor();
+            d=create<MultilingualBouquetNameDescriptor>(buffer);
             break;
          case MultilingualServiceNameDescriptorTag:
-            d=new MultilingualServiceNameDescriptor();
+            d=create<MultilingualServiceNameDescriptor>(buffer);
             break;
          case MultilingualComponentDescriptorTag:
-            d=new MultilingualComponentDescriptor();
+            d=create<MultilingualComponentDescriptor>(buffer);
             break;
          case PrivateDataSpecifierDescriptorTag:
-            d=new PrivateDataSpecifierDescriptor();
+            d=create<PrivateDataSpecifierDescriptor>(buffer);
             break;
          case ServiceMoveDescriptorTag:
-            d=new ServiceMoveDescriptor();
+            d=create<ServiceMoveDescriptor>(buffer);
             break;
          case FrequencyListDescriptorTag:
-            d=new FrequencyListDescriptor();
+            d=create<FrequencyListDescriptor>(buffer);
             break;
          case ServiceIdentifierDescriptorTag:
-            d=new ServiceIdentifierDescriptor();
+            d=create<ServiceIdentifierDescriptor>(buffer);
             break;
          case CaIdentifierDescriptorTag:
-            d=new CaIdentifierDescriptor();
+            d=create<CaIdentifierDescriptor>(buffer);
             break;
          case ShortEventDescriptorTag:
-            d=new ShortEventDescriptor();
+            d=create<ShortEventDescriptor>(buffer);
             break;
          case ExtendedEventDescriptorTag:
-            d=new ExtendedEventDescriptor();
+            d=create<ExtendedEventDescriptor>(buffer);
             break;
          case TimeShiftedEventDescriptorTag:
-            d=new TimeShiftedEventDescriptor();
+            d=create<TimeShiftedEventDescriptor>(buffer);
             break;
          case ContentDescriptorTag:
-            d=new ContentDescriptor();
+            d=create<ContentDescriptor>(buffer);
             break;
          case ParentalRatingDescriptorTag:
-            d=new ParentalRatingDescriptor();
+            d=create<ParentalRatingDescriptor>(buffer);
             break;
          case TeletextDescriptorTag:
          case VBITeletextDescriptorTag:
-            d=new TeletextDescriptor();
+            d=create<TeletextDescriptor>(buffer);
             break;
          case ApplicationSignallingDescriptorTag:
-            d=new ApplicationSignallingDescriptor();
+            d=create<ApplicationSignallingDescriptor>(buffer);
             break;
          case LocalTimeOffsetDescriptorTag:
-            d=new LocalTimeOffsetDescriptor();
+            d=create<LocalTimeOffsetDescriptor>(buffer);
             break;
          case LinkageDescriptorTag:
-            d=new LinkageDescriptor();
+            d=create<LinkageDescriptor>(buffer);
             break;
          case ISO639LanguageDescriptorTag:
-            d=new ISO639LanguageDescriptor();
+            d=create<ISO639LanguageDescriptor>(buffer);
             break;
          case PDCDescriptorTag:
-            d=new PDCDescriptor();
+            d=create<PDCDescriptor>(buffer);
             break;
          case AncillaryDataDescriptorTag:
-            d=new AncillaryDataDescriptor();
+            d=create<AncillaryDataDescriptor>(buffer);
             break;
          case S2SatelliteDeliverySystemDescriptorTag:
-            d=new S2SatelliteDeliverySystemDescriptor();
+            d=create<S2SatelliteDeliverySystemDescriptor>(buffer);
             break;
          case ExtensionDescriptorTag:
-            d=new ExtensionDescriptor();
+            d=create<ExtensionDescriptor>(buffer);
             break;
          case LogicalChannelDescriptorTag:
-            d=new LogicalChannelDescriptor();
+            d=create<LogicalChannelDescriptor>(buffer);
             break;
          case HdSimulcastLogicalChannelDescriptorTag:
-            d=new HdSimulcastLogicalChannelDescriptor();
+            d=create<HdSimulcastLogicalChannelDescriptor>(buffer);
             break;
          case RegistrationDescriptorTag:
-            d=new RegistrationDescriptor();
+            d=create<RegistrationDescriptor>(buffer);
             break;
          case ContentIdentifierDescriptorTag:
-            d=new ContentIdentifierDescriptor();
+            d=create<ContentIdentifierDescriptor>(buffer);
             break;
          case DefaultAuthorityDescriptorTag:
-            d=new DefaultAuthorityDescriptor();
+            d=create<DefaultAuthorityDescriptor>(buffer);
             break;
 
          //note that it is no problem to implement one
@@ -691,7 +759,7 @@ Descriptor *Descriptor::getDescriptor(CharArray da, DescriptorTagDomain domain,
          default:
             if (!returnUnimplemetedDescriptor)
                return 0;
-            d=new UnimplementedDescriptor();
+            d=create<UnimplementedDescriptor>(buffer);
             break;
       }
       break;
@@ -699,22 +767,22 @@ Descriptor *Descriptor::getDescriptor(CharArray da, DescriptorTagDomain domain,
       switch ((DescriptorTag)da.getData<DescriptorHeader>()->descriptor_tag) {
       // They once again start with 0x00 (see page 234, MHP specification)
          case MHP_ApplicationDescriptorTag:
-            d=new MHP_ApplicationDescriptor();
+            d=create<MHP_ApplicationDescriptor>(buffer);
             break;
          case MHP_ApplicationNameDescriptorTag:
-            d=new MHP_ApplicationNameDescriptor();
+            d=create<MHP_ApplicationNameDescriptor>(buffer);
             break;
          case MHP_TransportProtocolDescriptorTag:
-            d=new MHP_TransportProtocolDescriptor();
+            d=create<MHP_TransportProtocolDescriptor>(buffer);
             break;
          case MHP_DVBJApplicationDescriptorTag:
-            d=new MHP_DVBJApplicationDescriptor();
+            d=create<MHP_DVBJApplicationDescriptor>(buffer);
             break;
          case MHP_DVBJApplicationLocationDescriptorTag:
-            d=new MHP_DVBJApplicationLocationDescriptor();
+            d=create<MHP_DVBJApplicationLocationDescriptor>(buffer);
             break;
          case MHP_SimpleApplicationLocationDescriptorTag:
-            d=new MHP_SimpleApplicationLocationDescriptor();
+            d=create<MHP_SimpleApplicationLocationDescriptor>(buffer);
             break;
       // 0x05 - 0x0A is unimplemented this library
          case MHP_ExternalApplicationAuthorisationDescriptorTag:
@@ -730,28 +798,28 @@ Descriptor *Descriptor::getDescriptor(CharArray da, DescriptorTagDomain domain,
          default:
             if (!returnUnimplemetedDescriptor)
                return 0;
-            d=new UnimplementedDescriptor();
+            d=create<UnimplementedDescriptor>(buffer);
             break;
       }
       break;
    case PCIT:
       switch ((DescriptorTag)da.getData<DescriptorHeader>()->descriptor_tag) {
          case ContentDescriptorTag:
-            d=new ContentDescriptor();
+            d=create<ContentDescriptor>(buffer);
             break;
          case ShortEventDescriptorTag:
-            d=new ShortEventDescriptor();
+            d=create<ShortEventDescriptor>(buffer);
             break;
          case ExtendedEventDescriptorTag:
-            d=new ExtendedEventDescriptor();
+            d=create<ExtendedEventDescriptor>(buffer);
             break;
          case PremiereContentTransmissionDescriptorTag:
-            d=new PremiereContentTransmissionDescriptor();
+            d=create<PremiereContentTransmissionDescriptor>(buffer);
             break;
          default:
             if (!returnUnimplemetedDescriptor)
                return 0;
-            d=new UnimplementedDescriptor();
+            d=create<UnimplementedDescriptor>(buffer);
             break;
       }
       break;
@@ -299,6 +299,39 @@ private:
 class LoopElement : public Object {
 };
 
+class Descriptor;
+
+//Holds the descriptor returned by DescriptorLoop::getNext(Iterator &, DescriptorBuffer &).
+//The descriptor is constructed right inside the buffer (unless it is unusually big),
+//so iterating over a descriptor loop this way doesn't allocate any memory.
+//The descriptor is valid until the next call to getNext() with the same buffer,
+//or until the buffer is destroyed. Use detach() to keep it any longer.
+class DescriptorBuffer {
+public:
+   DescriptorBuffer() : descriptor(0), allocated(false), domain(SI) {}
+   ~DescriptorBuffer() { clear(); }
+   //destroys the descriptor held in this buffer
+   void clear();
+   //returns a copy of the descriptor held in this buffer, or 0 if there is none.
+   //The copy is allocated with new and must be delete'd.
+   Descriptor *detach();
+private:
+   friend class Descriptor;
+   DescriptorBuffer(const DescriptorBuffer &);
+   DescriptorBuffer &operator=(const DescriptorBuffer &);
+   //returns storage for an object of the given size, or 0 if it doesn't fit
+   void *allocate(unsigned int size);
+   Descriptor *descriptor;
+   bool allocated;
+   DescriptorTagDomain domain;
+   union {
+      void *p;
+      long long l;
+      double d;
+      unsigned char data[256];
+   } storage;
+};
+
 class Descriptor : public LoopElement {
 public:
    virtual int getLength();
@@ -315,7 +348,11 @@ protected:
    //   Never returns null - maybe the UnimplementedDescriptor.
    //if returnUnimplemetedDescriptor==false:
    //   Never returns the UnimplementedDescriptor - maybe null
-   static Descriptor *getDescriptor(CharArray d, DescriptorTagDomain domain, bool returnUnimplemetedDescriptor);
+   //If a buffer is given, the object is constructed in (and owned by) that buffer.
+   static Descriptor *getDescriptor(CharArray d, DescriptorTagDomain domain, bool returnUnimplemetedDescriptor, DescriptorBuffer *buffer=0);
+private:
+   friend class DescriptorBuffer;
+   template <class T> static Descriptor *create(DescriptorBuffer *buffer);
 };
 
 class Loop : public VariableLengthPart {
@@ -403,6 +440,11 @@ public:
    //In either case, a return value of 0 indicates that no further calls to this method
    //with the iterator shall be made.
    Descriptor *getNext(Iterator &it, DescriptorTag *tags, int arrayLength, bool returnUnimplemetedDescriptor=false);
+   //Same as the above, but the returned descriptor is held in the given buffer
+   //instead of being allocated with new, and must not be delete'd.
+   //Unimplemented descriptors are returned by the first version, and skipped by the second.
+   Descriptor *getNext(Iterator &it, DescriptorBuffer &buffer);
+   Descriptor *getNext(Iterator &it, DescriptorTag tag, DescriptorBuffer &buffer);
    //returns the number of descriptors in this loop
    int getNumberOfDescriptors();
    //writes the tags of the descriptors in this loop in the array,
@@ -422,7 +464,7 @@ public:
          return count;
       }
 protected:
-   Descriptor *createDescriptor(int &i, bool returnUnimplemetedDescriptor);
+   Descriptor *createDescriptor(int &i, bool returnUnimplemetedDescriptor, DescriptorBuffer *buffer=0);
    DescriptorTagDomain domain;
 };
 
@@ -152,6 +152,9 @@ public:
    static u_int32_t crc32(const char *d, int len, u_int32_t CRCvalue);
 protected:
    static u_int32_t crc_table[256];
+   //crc_slice[k][i] is the CRC of byte i followed by k+1 zero bytes, which allows
+   //processing 8 bytes at a time ("slicing-by-8")
+   static const u_int32_t crc_slice[7][256];
 
    const char *data;
    int length;
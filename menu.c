@@ -3222,8 +3222,10 @@ eOSState cMenuSetupEPG::ProcessKey(eKeys Key)
                }
             }
         }
-     if (Modified)
+     if (Modified) {
         cSchedules::ResetVersions();
+        cEitFilter::ResetSectionVersions();
+        }
      }
 
   int oldnumLanguages = numLanguages;
@@ -3704,6 +3706,7 @@ cMenuSetupRecord::cMenuSetupRecord(void)
   Add(new cMenuEditIntItem( tr("Setup.Recording$Max. video file size (MB)"), &data.MaxVideoFileSize, MINVIDEOFILESIZE, MAXVIDEOFILESIZETS));
   Add(new cMenuEditBoolItem(tr("Setup.Recording$Split edited files"),        &data.SplitEditedFiles));
   Add(new cMenuEditStraItem(tr("Setup.Recording$Delete timeshift recording"),&data.DelTimeshiftRec, 3, delTimeshiftRecTexts));
+  Add(new cMenuEditIntItem( tr("Setup.Recording$Max. copy rate (MB/s)"),     &data.MaxCopyRate, 0, 10000, tr("Setup.Recording$unlimited")));
 }
 
 // --- cMenuSetupReplay ------------------------------------------------------
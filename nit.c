@@ -72,7 +72,8 @@ void cNitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
         if (nit.getSectionNumber() == 0) {
            *nits[numNits].name = 0;
            SI::Descriptor *d;
-           for (SI::Loop::Iterator it; (d = nit.commonDescriptors.getNext(it)); ) {
+           SI::DescriptorBuffer DescriptorBuffer;
+           for (SI::Loop::Iterator it; (d = nit.commonDescriptors.getNext(it, DescriptorBuffer)); ) {
                switch (d->getDescriptorTag()) {
                  case SI::NetworkNameDescriptorTag: {
                       SI::NetworkNameDescriptor *nnd = (SI::NetworkNameDescriptor *)d;
@@ -81,7 +82,6 @@ void cNitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                       break;
                  default: ;
                  }
-               delete d;
                }
            nits[numNits].networkId = nit.getNetworkId();
            nits[numNits].hasTransponder = false;
@@ -100,9 +100,10 @@ void cNitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
   SI::NIT::TransportStream ts;
   for (SI::Loop::Iterator it; nit.transportStreamLoop.getNext(ts, it); ) {
       SI::Descriptor *d;
+      SI::DescriptorBuffer DescriptorBuffer;
 
       SI::Loop::Iterator it2;
-      SI::FrequencyListDescriptor *fld = (SI::FrequencyListDescriptor *)ts.transportStreamDescriptors.getNext(it2, SI::FrequencyListDescriptorTag);
+      SI::FrequencyListDescriptor *fld = (SI::FrequencyListDescriptor *)ts.transportStreamDescriptors.getNext(it2, SI::FrequencyListDescriptorTag, DescriptorBuffer);
       int NumFrequencies = fld ? fld->frequencies.getCount() + 1 : 1;
       int Frequencies[NumFrequencies];
       if (fld) {
@@ -123,9 +124,8 @@ void cNitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
          else
             NumFrequencies = 1;
          }
-      delete fld;
 
-      for (SI::Loop::Iterator it2; (d = ts.transportStreamDescriptors.getNext(it2)); ) {
+      for (SI::Loop::Iterator it2; (d = ts.transportStreamDescriptors.getNext(it2, DescriptorBuffer)); ) {
           switch (d->getDescriptorTag()) {
             case SI::SatelliteDeliverySystemDescriptorTag: {
                  SI::SatelliteDeliverySystemDescriptor *sd = (SI::SatelliteDeliverySystemDescriptor *)d;
@@ -395,7 +395,6 @@ void cNitFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                  break;
             default: ;
             }
-          delete d;
           }
       }
   Channels.Unlock();
@@ -403,11 +403,11 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
      cChannel *Channel = Channels.GetByServiceID(Source(), Transponder(), pmt.getServiceId());
      if (Channel) {
         SI::CaDescriptor *d;
+        SI::DescriptorBuffer DescriptorBuffer;
         cCaDescriptors *CaDescriptors = new cCaDescriptors(Channel->Source(), Channel->Transponder(), Channel->Sid(), Pid);
         // Scan the common loop:
-        for (SI::Loop::Iterator it; (d = (SI::CaDescriptor*)pmt.commonDescriptors.getNext(it, SI::CaDescriptorTag)); ) {
+        for (SI::Loop::Iterator it; (d = (SI::CaDescriptor*)pmt.commonDescriptors.getNext(it, SI::CaDescriptorTag, DescriptorBuffer)); ) {
             CaDescriptors->AddCaDescriptor(d, 0);
-            delete d;
             }
         // Scan the stream-specific loop:
         SI::PMT::Stream stream;
@@ -450,7 +450,7 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                          Apids[NumApids] = esPid;
                          Atypes[NumApids] = stream.getStreamType();
                          SI::Descriptor *d;
-                         for (SI::Loop::Iterator it; (d = stream.streamDescriptors.getNext(it)); ) {
+                         for (SI::Loop::Iterator it; (d = stream.streamDescriptors.getNext(it, DescriptorBuffer)); ) {
                              switch (d->getDescriptorTag()) {
                                case SI::ISO639LanguageDescriptorTag: {
                                     SI::ISO639LanguageDescriptor *ld = (SI::ISO639LanguageDescriptor *)d;
@@ -471,7 +471,6 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                                     break;
                                default: ;
                                }
-                             delete d;
                              }
                          NumApids++;
                          }
@@ -486,7 +485,7 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                       int dtype = 0;
                       char lang[MAXLANGCODE1] = { 0 };
                       SI::Descriptor *d;
-                      for (SI::Loop::Iterator it; (d = stream.streamDescriptors.getNext(it)); ) {
+                      for (SI::Loop::Iterator it; (d = stream.streamDescriptors.getNext(it, DescriptorBuffer)); ) {
                           switch (d->getDescriptorTag()) {
                             case SI::AC3DescriptorTag:
                             case SI::EnhancedAC3DescriptorTag:
@@ -527,7 +526,6 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                                  break;
                             default: ;
                             }
-                          delete d;
                           }
                       if (dpid) {
                          if (NumDpids < MAXDPIDS) {
@@ -552,7 +550,7 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                       if (Setup.StandardCompliance == STANDARD_ANSISCTE) { // ATSC A/53 AUDIO (ANSI/SCTE 57)
                          char lang[MAXLANGCODE1] = { 0 };
                          SI::Descriptor *d;
-                         for (SI::Loop::Iterator it; (d = stream.streamDescriptors.getNext(it)); ) {
+                         for (SI::Loop::Iterator it; (d = stream.streamDescriptors.getNext(it, DescriptorBuffer)); ) {
                              switch (d->getDescriptorTag()) {
                                case SI::ISO639LanguageDescriptorTag: {
                                     SI::ISO639LanguageDescriptor *ld = (SI::ISO639LanguageDescriptor *)d;
@@ -561,7 +559,6 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                                     break;
                                default: ;
                                }
-                            delete d;
                             }
                          if (NumDpids < MAXDPIDS) {
                             Dpids[NumDpids] = esPid;
@@ -584,7 +581,7 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                       char lang[MAXLANGCODE1] = { 0 };
                       bool IsAc3 = false;
                       SI::Descriptor *d;
-                      for (SI::Loop::Iterator it; (d = stream.streamDescriptors.getNext(it)); ) {
+                      for (SI::Loop::Iterator it; (d = stream.streamDescriptors.getNext(it, DescriptorBuffer)); ) {
                           switch (d->getDescriptorTag()) {
                             case SI::RegistrationDescriptorTag: {
                                  SI::RegistrationDescriptor *rd = (SI::RegistrationDescriptor *)d;
@@ -606,7 +603,6 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                                  break;
                             default: ;
                             }
-                         delete d;
                          }
                       if (IsAc3) {
                          if (NumDpids < MAXDPIDS) {
@@ -622,9 +618,8 @@ void cPatFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
               default: ;//printf("PID: %5d %5d %2d %3d %3d\n", pmt.getServiceId(), stream.getPid(), stream.getStreamType(), pmt.getVersionNumber(), Channel->Number());
               }
             if (ProcessCaDescriptors) {
-               for (SI::Loop::Iterator it; (d = (SI::CaDescriptor*)stream.streamDescriptors.getNext(it, SI::CaDescriptorTag)); ) {
+               for (SI::Loop::Iterator it; (d = (SI::CaDescriptor*)stream.streamDescriptors.getNext(it, SI::CaDescriptorTag, DescriptorBuffer)); ) {
                    CaDescriptors->AddCaDescriptor(d, esPid);
-                   delete d;
                    }
                }
             }
@@ -99,6 +99,23 @@ void cReceiver::DelPids(const int *Pids)
      }
 }
 
+void cReceiver::ReceiveBlock(uchar *Data, int Length)
+{
+  for (; Length >= TS_SIZE; Data += TS_SIZE, Length -= TS_SIZE)
+      Receive(Data, TS_SIZE);
+}
+
+bool cReceiver::WantsSamePids(const cReceiver *Receiver) const
+{
+  if (Receiver->numPids != numPids || !(Receiver->channelID == channelID))
+     return false;
+  for (int i = 0; i < numPids; i++) {
+      if (Receiver->pids[i] != pids[i])
+         return false;
+      }
+  return true;
+}
+
 bool cReceiver::WantsPid(int Pid)
 {
   if (Pid) {
@@ -23,6 +23,7 @@ private:
   int pids[MAXRECEIVEPIDS];
   int numPids;
   bool WantsPid(int Pid);
+  bool WantsSamePids(const cReceiver *Receiver) const;
 protected:
   cDevice *Device(void) { return device; }
   void Detach(void);
@@ -38,6 +39,23 @@ protected:
                ///< as soon as possible, without any unnecessary delay. Each TS packet
                ///< will be delivered only ONCE, so the cReceiver must make sure that
                ///< it will be able to buffer the data if necessary.
+  virtual void ReceiveBlock(uchar *Data, int Length);
+               ///< This function is called from the cDevice we are attached to, and
+               ///< delivers a block of Length / TS_SIZE consecutive TS packets from the
+               ///< set of PIDs the cReceiver has requested. The same rules as for Receive()
+               ///< apply. The default implementation calls Receive() for each individual
+               ///< TS packet. Derived classes that copy the data into a buffer anyway can
+               ///< reimplement this function to handle the whole block at once.
+  virtual bool ShareData(cReceiver *Receiver) { return false; }
+               ///< This function is called from the cDevice we are attached to, right
+               ///< before the given Receiver, which wants exactly the same PIDs as this
+               ///< one, gets attached to the same device. If this receiver is able to
+               ///< make the data it receives available to Receiver by itself, it shall
+               ///< set this up and return true. The device will then deliver the data
+               ///< only to this receiver. If this receiver gets detached, the device
+               ///< continues delivering the data to one of the receivers sharing it, so
+               ///< all of them must be able to take over feeding the others.
+               ///< The default implementation doesn't share any data.
 public:
   cReceiver(const cChannel *Channel = NULL, int Priority = MINPRIORITY);
                ///< Creates a new receiver for the given Channel with the given Priority.
@@ -45,6 +63,8 @@ public:
                ///< Otherwise pids can be added to the receiver by separate calls to the AddPid[s]
                ///< functions.
                ///< The total number of PIDs added to a receiver must not exceed MAXRECEIVEPIDS.
+               ///< The PIDs must not be changed while the receiver is attached to a device
+               ///< (detach it, change the PIDs and attach it again).
                ///< Priority may be any value in the range MINPRIORITY...MAXPRIORITY. Negative values indicate
                ///< that this cReceiver may be detached at any time in favor of a timer recording
                ///< or live viewing (without blocking the cDevice it is attached to).
@@ -10,7 +10,7 @@
 #include "recorder.h"
 #include "shutdown.h"
 
-#define RECORDERBUFSIZE  (MEGABYTE(20) / TS_SIZE * TS_SIZE) // multiple of TS_SIZE
+#define RECORDERBUFSIZE  (BUFFERSIZE(Setup.RecorderBufferSize) / TS_SIZE * TS_SIZE) // multiple of TS_SIZE
 
 // The maximum time we wait before assuming that a recorded video data stream
 // is broken:
@@ -31,9 +31,10 @@ cRecorder::cRecorder(const char *FileName, const cChannel *Channel, int Priority
 
   SpinUpDisk(FileName);
 
-  ringBuffer = new cRingBufferLinear(RECORDERBUFSIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE, true, "Recorder");
+  ringBuffer = new cRingBufferShared(RECORDERBUFSIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE, true, "Recorder");
   ringBuffer->SetTimeouts(0, 100);
   ringBuffer->SetIoThrottle();
+  reader = ringBuffer->AddReader();
 
   int Pid = Channel->Vpid();
   int Type = Channel->Vtype();
@@ -47,37 +48,39 @@ cRecorder::cRecorder(const char *FileName, const cChannel *Channel, int Priority
      }
   frameDetector = new cFrameDetector(Pid, Type);
   index = NULL;
-  fileSize = 0;
+  writer = NULL;
   lastDiskSpaceCheck = time(NULL);
   fileName = new cFileName(FileName, true);
   int PatVersion, PmtVersion;
   if (fileName->GetLastPatPmtVersions(PatVersion, PmtVersion))
      patPmtGenerator.SetVersions(PatVersion + 1, PmtVersion + 1);
   patPmtGenerator.SetChannel(Channel);
-  recordFile = fileName->Open();
-  if (!recordFile)
+  if (!fileName->Open())
      return;
   // Create the index file:
   index = new cIndexFile(FileName, true);
   if (!index)
      esyslog("ERROR: can't allocate index");
      // let's continue without index, so we'll at least have the recording
+  writer = new cRecordingWriter(fileName, index);
 }
 
 cRecorder::~cRecorder()
 {
   Detach();
+  delete writer; // writes any pending data
   delete index;
   delete fileName;
   delete frameDetector;
-  delete ringBuffer;
+  if (ringBuffer->DelReader(reader) == 0)
+     delete ringBuffer;
   free(recordingName);
 }
 
 bool cRecorder::RunningLowOnDiskSpace(void)
 {
   if (time(NULL) > lastDiskSpaceCheck + DISKCHECKINTERVAL) {
-     int Free = FreeDiskSpaceMB(fileName->Name());
+     int Free = FreeDiskSpaceMB(recordingName);
      lastDiskSpaceCheck = time(NULL);
      if (Free < MINFREEDISKSPACE) {
         dsyslog("low disk space (%d MB, limit is %d MB)", Free, MINFREEDISKSPACE);
@@ -89,13 +92,11 @@ bool cRecorder::RunningLowOnDiskSpace(void)
 
 bool cRecorder::NextFile(void)
 {
-  if (recordFile && frameDetector->IndependentFrame()) { // every file shall start with an independent frame
-     if (fileSize > MEGABYTE(off_t(Setup.MaxVideoFileSize)) || RunningLowOnDiskSpace()) {
-        recordFile = fileName->NextFile();
-        fileSize = 0;
-        }
+  if (writer && frameDetector->IndependentFrame()) { // every file shall start with an independent frame
+     if (writer->FileSize() > MEGABYTE(off_t(Setup.MaxVideoFileSize)) || RunningLowOnDiskSpace())
+        writer->NextFile();
      }
-  return recordFile != NULL;
+  return writer && !writer->Error();
 }
 
 void cRecorder::Activate(bool On)
@@ -108,21 +109,47 @@ void cRecorder::Activate(bool On)
 
 void cRecorder::Receive(uchar *Data, int Length)
 {
-  if (Running()) {
-     int p = ringBuffer->Put(Data, Length);
-     if (p != Length && Running())
-        ringBuffer->ReportOverflow(Length - p);
+  // The data is put into the buffer even if this recorder's thread has ended,
+  // since other recorders may share the buffer:
+  int p = ringBuffer->Put(Data, Length);
+  if (p != Length)
+     ringBuffer->ReportOverflow(Length - p);
+}
+
+void cRecorder::ReceiveBlock(uchar *Data, int Length)
+{
+  Receive(Data, Length);
+}
+
+bool cRecorder::ShareData(cReceiver *Receiver)
+{
+  if (cRecorder *Recorder = dynamic_cast<cRecorder *>(Receiver)) {
+     int Reader = ringBuffer->AddReader();
+     if (Reader >= 0) {
+        // Recorder hasn't been activated yet, so it doesn't use its own buffer:
+        if (Recorder->ringBuffer->DelReader(Recorder->reader) == 0)
+           delete Recorder->ringBuffer;
+        Recorder->ringBuffer = ringBuffer;
+        Recorder->reader = Reader;
+        dsyslog("recording %s shares its data with %s", recordingName, Recorder->recordingName);
+        return true;
+        }
      }
+  return false;
 }
 
 void cRecorder::Action(void)
 {
+  if (!writer) {
+     ringBuffer->StopReader(reader);
+     return; // the recording file couldn't be opened
+     }
   cTimeMs t(MAXBROKENTIMEOUT);
   bool InfoWritten = false;
   bool FirstIframeSeen = false;
   while (Running()) {
         int r;
-        uchar *b = ringBuffer->Get(r);
+        uchar *b = writer->WaitForSpace(100) ? ringBuffer->Get(reader, r) : NULL;
         if (b) {
            int Count = frameDetector->Analyze(b, r);
            if (Count) {
@@ -146,26 +173,19 @@ void cRecorder::Action(void)
                     if (!NextFile())
                        break;
                     if (index && frameDetector->NewFrame())
-                       index->Write(frameDetector->IndependentFrame(), fileName->Number(), fileSize);
+                       writer->WriteIndex(frameDetector->IndependentFrame());
                     if (frameDetector->IndependentFrame()) {
-                       recordFile->Write(patPmtGenerator.GetPat(), TS_SIZE);
-                       fileSize += TS_SIZE;
+                       writer->Write(patPmtGenerator.GetPat(), TS_SIZE);
                        int Index = 0;
-                       while (uchar *pmt = patPmtGenerator.GetPmt(Index)) {
-                             recordFile->Write(pmt, TS_SIZE);
-                             fileSize += TS_SIZE;
-                             }
+                       while (uchar *pmt = patPmtGenerator.GetPmt(Index))
+                             writer->Write(pmt, TS_SIZE);
                        t.Set(MAXBROKENTIMEOUT);
                        }
-                    if (recordFile->Write(b, Count) < 0) {
-                       LOG_ERROR_STR(fileName->Name());
-                       break;
-                       }
-                    fileSize += Count;
+                    writer->Write(b, Count);
                     }
                  }
-              ringBuffer->Del(Count);
               }
+           ringBuffer->Del(reader, Count);
            }
         if (t.TimedOut()) {
            esyslog("ERROR: video data stream broken");
@@ -173,4 +193,5 @@ void cRecorder::Action(void)
            t.Set(MAXBROKENTIMEOUT);
            }
         }
+  ringBuffer->StopReader(reader); // any recorders sharing the buffer keep getting their data
 }
@@ -18,14 +18,14 @@
 
 class cRecorder : public cReceiver, cThread {
 private:
-  cRingBufferLinear *ringBuffer;
+  cRingBufferShared *ringBuffer;
+  int reader;
   cFrameDetector *frameDetector;
   cPatPmtGenerator patPmtGenerator;
   cFileName *fileName;
   cIndexFile *index;
-  cUnbufferedFile *recordFile;
+  cRecordingWriter *writer;
   char *recordingName;
-  off_t fileSize;
   time_t lastDiskSpaceCheck;
   bool RunningLowOnDiskSpace(void);
   bool NextFile(void);
@@ -36,6 +36,10 @@ protected:
        ///< to properly get a call to Activate(false) when your object is
        ///< destroyed.
   virtual void Receive(uchar *Data, int Length);
+  virtual void ReceiveBlock(uchar *Data, int Length);
+  virtual bool ShareData(cReceiver *Receiver);
+       ///< Recorders of the same channel on the same device share one ring buffer,
+       ///< so that every TS packet is copied only once.
   virtual void Action(void);
 public:
   cRecorder(const char *FileName, const cChannel *Channel, int Priority);
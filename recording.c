@@ -17,7 +17,11 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include "channels.h"
 #include "cutter.h"
@@ -809,6 +813,16 @@ cRecording::cRecording(cTimer *Timer, const cEvent *Event)
 }
 
 cRecording::cRecording(const char *FileName)
+{
+  Construct(FileName, NULL);
+}
+
+cRecording::cRecording(const char *FileName, const char *InfoData)
+{
+  Construct(FileName, InfoData);
+}
+
+void cRecording::Construct(const char *FileName, const char *InfoData)
 {
   resume = RESUME_NOT_INITIALIZED;
   fileSizeMB = -1; // unknown
@@ -852,9 +866,9 @@ cRecording::cRecording(const char *FileName)
      else
         return;
      GetResume();
-     // read an optional info file:
+     // read an optional info file (or the copy of it in the recordings catalog):
      cString InfoFileName = cString::sprintf("%s%s", fileName, isPesRecording ? INFOFILESUFFIX ".vdr" : INFOFILESUFFIX);
-     FILE *f = fopen(InfoFileName, "r");
+     FILE *f = InfoData ? fmemopen((void *)InfoData, strlen(InfoData), "r") : fopen(InfoFileName, "r");
      if (f) {
         if (!info->Read(f))
            esyslog("ERROR: EPG data problem in file %s", *InfoFileName);
@@ -1360,6 +1374,891 @@ int cRecording::FileSizeMB(void) const
   return fileSizeMB;
 }
 
+// --- cRecordingsCatalog ----------------------------------------------------
+
+// The recordings catalog holds the names of all folders and recordings in the
+// video directory, together with the modification times of their directories.
+// For recordings it also keeps the data that would otherwise have to be
+// collected from several files. A directory that still has the modification
+// time stored in the catalog doesn't need to be read again.
+// The layout of the catalog file is
+//   tRecordingsCatalogHeader
+//   for each directory: tRecordingsCatalogEntry, the directory's name relative
+//     to the video directory and, for recordings, the contents of the info file
+//     (each 0 terminated)
+
+#define RECCATALOGMAGIC     "VDR-REC\n"
+#define RECCATALOGVERSION   1
+#define RECCATALOGBYTEORDER 0x01020304
+#define RECCATALOGHASHSIZE  8192
+
+struct tRecordingsCatalogHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  };
+
+struct tRecordingsCatalogEntry {
+  int64_t modified; // 0 = unknown
+  int32_t numFrames;
+  int32_t fileSizeMB;
+  int8_t isOnVideoDirectoryFileSystem;
+  uint8_t recording;
+  uint8_t link;
+  };
+
+class cRecordingsCatalogEntry : public cListObject {
+public:
+  char *name; // relative to the video directory
+  time_t modified;
+  bool recording;
+  bool link;
+  int numFrames;
+  int fileSizeMB;
+  int isOnVideoDirectoryFileSystem;
+  const char *info; // points into the data read from the catalog file
+  cVector<cRecordingsCatalogEntry *> children;
+  cRecordingsCatalogEntry(const char *Name, time_t Modified, bool Recording, bool Link);
+  virtual ~cRecordingsCatalogEntry();
+  const char *BaseName(void) const;
+  };
+
+cRecordingsCatalogEntry::cRecordingsCatalogEntry(const char *Name, time_t Modified, bool Recording, bool Link)
+{
+  name = strdup(Name);
+  modified = Modified;
+  recording = Recording;
+  link = Link;
+  numFrames = -1;
+  fileSizeMB = -1;
+  isOnVideoDirectoryFileSystem = -1;
+  info = NULL;
+}
+
+cRecordingsCatalogEntry::~cRecordingsCatalogEntry()
+{
+  free(name);
+}
+
+const char *cRecordingsCatalogEntry::BaseName(void) const
+{
+  const char *p = strrchr(name, '/');
+  return p ? p + 1 : name;
+}
+
+class cRecordingsCatalog {
+private:
+  cMutex mutex;
+  char *fileName;
+  char *data;
+  bool read;
+  bool modified;
+  time_t scanStart;
+  cList<cRecordingsCatalogEntry> entries;
+  cList<cRecordingsCatalogEntry> scanned;
+  cHash<cRecordingsCatalogEntry> hash;
+  static const char *RelativeName(const char *FileName);
+  static const char *GetString(const char *&p, const char *End);
+  cRecordingsCatalogEntry *Find(const char *Name) const;
+  void Link(void);
+  bool Read(void);
+  bool Write(cRecordings *Recordings);
+public:
+  cRecordingsCatalog(const char *FileName);
+  ~cRecordingsCatalog();
+  static unsigned int Hash(const char *s);
+       ///< Returns the hash value of the given string (used for file names).
+  void Begin(time_t Now);
+       ///< Begins a scan of the video directory that started at the time Now.
+       ///< The first call reads the catalog file.
+  const cRecordingsCatalogEntry *Get(const char *FileName, time_t Modified) const;
+       ///< Returns the entry of the directory with the given FileName, or NULL if
+       ///< there is none or the directory has been modified since it was stored.
+  void Add(const char *FileName, time_t Modified, bool Recording, bool Link);
+       ///< Adds the directory with the given FileName that has been found in the
+       ///< current scan. May be called by several threads at once.
+  void End(cRecordings *Recordings, bool Complete);
+       ///< Ends the current scan and writes the catalog file if anything has
+       ///< changed. If the scan wasn't Complete, the file is left untouched.
+  };
+
+cRecordingsCatalog::cRecordingsCatalog(const char *FileName)
+:hash(RECCATALOGHASHSIZE)
+{
+  fileName = strdup(FileName);
+  data = NULL;
+  read = false;
+  modified = false;
+  scanStart = 0;
+}
+
+cRecordingsCatalog::~cRecordingsCatalog()
+{
+  hash.Clear();
+  free(data);
+  free(fileName);
+}
+
+unsigned int cRecordingsCatalog::Hash(const char *s)
+{
+  unsigned int h = 2166136261u; // FNV-1a
+  while (*s)
+        h = (h ^ uchar(*s++)) * 16777619u;
+  return h;
+}
+
+const char *cRecordingsCatalog::RelativeName(const char *FileName)
+{
+  const char *VideoDirectory = cVideoDirectory::Name();
+  int l = strlen(VideoDirectory);
+  if (strncmp(FileName, VideoDirectory, l) == 0 && (FileName[l] == '/' || !FileName[l]))
+     return FileName + l + (FileName[l] == '/');
+  return FileName;
+}
+
+const char *cRecordingsCatalog::GetString(const char *&p, const char *End)
+{
+  const char *s = p;
+  const char *e = (const char *)memchr(p, 0, End - p);
+  if (!e)
+     return NULL;
+  p = e + 1;
+  return s;
+}
+
+cRecordingsCatalogEntry *cRecordingsCatalog::Find(const char *Name) const
+{
+  if (cList<cHashObject> *list = hash.GetList(Hash(Name))) {
+     for (cHashObject *hob = list->First(); hob; hob = list->Next(hob)) {
+         cRecordingsCatalogEntry *e = (cRecordingsCatalogEntry *)hob->Object();
+         if (strcmp(e->name, Name) == 0)
+            return e;
+         }
+     }
+  return NULL;
+}
+
+void cRecordingsCatalog::Link(void)
+{
+  hash.Clear();
+  for (cRecordingsCatalogEntry *e = entries.First(); e; e = entries.Next(e))
+      hash.Add(e, Hash(e->name));
+  for (cRecordingsCatalogEntry *e = entries.First(); e; e = entries.Next(e)) {
+      if (*e->name) { // the video directory itself has no parent
+         const char *p = strrchr(e->name, '/');
+         if (cRecordingsCatalogEntry *Folder = Find(p ? *cString(e->name, p) : ""))
+            Folder->children.Append(e);
+         }
+      }
+}
+
+bool cRecordingsCatalog::Read(void)
+{
+  int f = open(fileName, O_RDONLY);
+  if (f < 0) {
+     if (errno != ENOENT)
+        LOG_ERROR_STR(fileName);
+     return false;
+     }
+  cTimeMs Timer;
+  bool Result = false;
+  struct stat st;
+  if (fstat(f, &st) == 0 && size_t(st.st_size) >= sizeof(tRecordingsCatalogHeader)) {
+     // The whole file is read at once, and the info data is used right from this buffer:
+     data = MALLOC(char, st.st_size);
+     if (data && safe_read(f, data, st.st_size) == st.st_size) {
+        tRecordingsCatalogHeader ch;
+        memcpy(&ch, data, sizeof(ch));
+        if (memcmp(ch.magic, RECCATALOGMAGIC, sizeof(ch.magic)) == 0 && ch.version == RECCATALOGVERSION && ch.byteOrder == RECCATALOGBYTEORDER) {
+           const char *p = data + sizeof(ch);
+           const char *End = data + st.st_size;
+           Result = true;
+           while (p < End) {
+                 tRecordingsCatalogEntry ce;
+                 const char *Name = NULL;
+                 const char *Info = NULL;
+                 if (End - p >= int(sizeof(ce))) {
+                    memcpy(&ce, p, sizeof(ce));
+                    p += sizeof(ce);
+                    if ((Name = GetString(p, End)) != NULL && ce.recording)
+                       Info = GetString(p, End);
+                    }
+                 if (!Name || ce.recording && !Info) {
+                    esyslog("ERROR: recordings catalog '%s' is broken at offset %d", fileName, int(p - data));
+                    entries.Clear();
+                    Result = false;
+                    break;
+                    }
+                 cRecordingsCatalogEntry *e = new cRecordingsCatalogEntry(Name, ce.modified, ce.recording, ce.link);
+                 e->numFrames = ce.numFrames;
+                 e->fileSizeMB = ce.fileSizeMB;
+                 e->isOnVideoDirectoryFileSystem = ce.isOnVideoDirectoryFileSystem;
+                 e->info = Info;
+                 entries.Add(e);
+                 }
+           }
+        else
+           isyslog("recordings catalog '%s' has an unknown format - ignored", fileName);
+        }
+     else
+        LOG_ERROR_STR(fileName);
+     }
+  close(f);
+  if (Result) {
+     Link();
+     dsyslog("read recordings catalog (%d entries) in %d ms", entries.Count(), int(Timer.Elapsed()));
+     }
+  else {
+     free(data);
+     data = NULL;
+     }
+  return Result;
+}
+
+bool cRecordingsCatalog::Write(cRecordings *Recordings)
+{
+  cTimeMs Timer;
+  bool Result = false;
+  int LockedMs = 0;
+  // The catalog is put together in memory while the recordings are locked,
+  // and is written to disk only after the lock has been released:
+  char *Buffer = NULL;
+  size_t Size = 0;
+  if (FILE *f = open_memstream(&Buffer, &Size)) {
+     tRecordingsCatalogHeader ch;
+     memcpy(ch.magic, RECCATALOGMAGIC, sizeof(ch.magic));
+     ch.version = RECCATALOGVERSION;
+     ch.byteOrder = RECCATALOGBYTEORDER;
+     Result = fwrite(&ch, sizeof(ch), 1, f) == 1;
+     {
+       cThreadLock RecordingsLock(Recordings);
+       cTimeMs LockTimer;
+       cHash<cRecording> ByName(RECCATALOGHASHSIZE);
+       for (cRecording *r = Recordings->First(); r; r = Recordings->Next(r))
+           ByName.Add(r, Hash(RelativeName(r->FileName())));
+       for (cRecordingsCatalogEntry *e = scanned.First(); Result && e; e = scanned.Next(e)) {
+           cRecording *Recording = NULL;
+           if (e->recording) {
+              if (cList<cHashObject> *list = ByName.GetList(Hash(e->name))) {
+                 for (cHashObject *hob = list->First(); hob; hob = list->Next(hob)) {
+                     cRecording *r = (cRecording *)hob->Object();
+                     if (strcmp(RelativeName(r->FileName()), e->name) == 0) {
+                        Recording = r;
+                        break;
+                        }
+                     }
+                 }
+              if (!Recording)
+                 continue; // has vanished in the meantime, or isn't a valid recording
+              }
+           tRecordingsCatalogEntry ce;
+           memset(&ce, 0, sizeof(ce));
+           ce.modified = e->modified;
+           ce.recording = e->recording;
+           ce.link = e->link;
+           ce.numFrames = Recording ? Recording->numFrames : -1;
+           ce.fileSizeMB = Recording ? Recording->fileSizeMB : -1;
+           ce.isOnVideoDirectoryFileSystem = Recording ? Recording->isOnVideoDirectoryFileSystem : -1;
+           Result = fwrite(&ce, sizeof(ce), 1, f) == 1 && fwrite(e->name, strlen(e->name) + 1, 1, f) == 1;
+           if (Result && Recording)
+              Result = Recording->info->Write(f) && fputc(0, f) != EOF;
+           }
+       LockedMs = LockTimer.Elapsed();
+     }
+     if (fclose(f) != 0)
+        Result = false;
+     }
+  else
+     LOG_ERROR;
+  if (Result) {
+     cSafeFile f(fileName);
+     if (f.Open()) {
+        Result = fwrite(Buffer, Size, 1, f) == 1;
+        if (!f.Close())
+           Result = false;
+        }
+     else {
+        LOG_ERROR_STR(fileName);
+        Result = false;
+        }
+     }
+  free(Buffer);
+  if (Result)
+     dsyslog("wrote recordings catalog (%d entries, %d KB) in %d ms (recordings locked for %d ms)", scanned.Count(), int(Size / KILOBYTE(1)), int(Timer.Elapsed()), LockedMs);
+  return Result;
+}
+
+void cRecordingsCatalog::Begin(time_t Now)
+{
+  if (!read) {
+     Read();
+     read = true;
+     }
+  scanned.Clear();
+  modified = false;
+  scanStart = Now;
+}
+
+const cRecordingsCatalogEntry *cRecordingsCatalog::Get(const char *FileName, time_t Modified) const
+{
+  if (Modified) {
+     cRecordingsCatalogEntry *e = Find(RelativeName(FileName));
+     if (e && e->modified == Modified)
+        return e;
+     }
+  return NULL;
+}
+
+void cRecordingsCatalog::Add(const char *FileName, time_t Modified, bool Recording, bool Link)
+{
+  const char *Name = RelativeName(FileName);
+  if (Modified >= scanStart)
+     Modified = 0; // the directory might be modified again within the same second
+  cRecordingsCatalogEntry *e = Find(Name);
+  cMutexLock MutexLock(&mutex);
+  if (!e || e->modified != Modified || e->recording != Recording || e->link != Link)
+     modified = true;
+  scanned.Add(new cRecordingsCatalogEntry(Name, Modified, Recording, Link));
+}
+
+void cRecordingsCatalog::End(cRecordings *Recordings, bool Complete)
+{
+  if (Complete) {
+     if (modified || scanned.Count() != entries.Count())
+        Write(Recordings);
+     // The entries of this scan are used to check for changes in the next one:
+     hash.Clear();
+     entries.Clear();
+     while (cRecordingsCatalogEntry *e = scanned.First()) {
+           scanned.Del(e, false);
+           entries.Add(e);
+           }
+     Link();
+     }
+  else {
+     scanned.Clear();
+     for (cRecordingsCatalogEntry *e = entries.First(); e; e = entries.Next(e))
+         e->info = NULL;
+     }
+  free(data); // the info data is only needed for the initial scan
+  data = NULL;
+}
+
+// --- cRecordingsWatcher ----------------------------------------------------
+
+#define WATCHEREVENTS  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE)
+#define WATCHERTIMEOUT 1000 // ms to wait for events before checking whether the thread shall end
+
+class cRecordingsWatch : public cListObject {
+public:
+  int wd;
+  char *path;
+  cRecordingsWatch(int Wd, const char *Path) { wd = Wd; path = strdup(Path); }
+  virtual ~cRecordingsWatch() { free(path); }
+  };
+
+class cRecordingsWatcher : public cThread {
+private:
+  cMutex mutex;
+  int fd;
+  bool failed;
+  bool overflow;
+  cRecordings *recordings;
+  cList<cRecordingsWatch> watches;
+  cHash<cRecordingsWatch> hash;
+  cString GetPath(int Wd);
+  void Forget(const char *Path);
+  void Scan(const char *DirName, int LinkLevel = 0);
+  void Process(const struct inotify_event *Event);
+protected:
+  virtual void Action(void);
+public:
+  cRecordingsWatcher(cRecordings *Recordings);
+  virtual ~cRecordingsWatcher();
+  bool Watching(void) { return fd >= 0 && !failed; }
+       ///< Returns true if all directories of the video directory are being watched.
+  bool Overflow(void);
+       ///< Returns true if events have been lost since the last call, so that the
+       ///< list of recordings needs to be updated by scanning the video directory.
+  void Watch(const char *DirName);
+       ///< Starts watching the directory with the given DirName (if it isn't
+       ///< watched already). This is done by cRecordingsScanner for every folder
+       ///< and recording, before the directory's contents are examined.
+  };
+
+cRecordingsWatcher::cRecordingsWatcher(cRecordings *Recordings)
+:cThread("recordings watcher")
+,hash(RECCATALOGHASHSIZE)
+{
+  recordings = Recordings;
+  failed = false;
+  overflow = false;
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+     LOG_ERROR;
+}
+
+cRecordingsWatcher::~cRecordingsWatcher()
+{
+  Cancel(3);
+  hash.Clear();
+  if (fd >= 0)
+     close(fd);
+}
+
+bool cRecordingsWatcher::Overflow(void)
+{
+  cMutexLock MutexLock(&mutex);
+  bool Result = overflow;
+  overflow = false;
+  return Result;
+}
+
+void cRecordingsWatcher::Watch(const char *DirName)
+{
+  if (endswith(DirName, DELEXT))
+     return; // deleted recordings are not watched
+  cMutexLock MutexLock(&mutex);
+  if (!Watching())
+     return;
+  int wd = inotify_add_watch(fd, DirName, WATCHEREVENTS | IN_ONLYDIR);
+  if (wd < 0) {
+     if (errno == ENOENT || errno == ENOTDIR)
+        return; // has vanished in the meantime
+     if (errno == ENOSPC)
+        esyslog("ERROR: can't watch all directories in %s - falling back to polling (see /proc/sys/fs/inotify/max_user_watches)", cVideoDirectory::Name());
+     else
+        LOG_ERROR_STR(DirName);
+     failed = true;
+     if (Running())
+        recordings->lastUpdate = 0; // events may have been missed, so a full update is necessary
+     return;
+     }
+  cRecordingsWatch *w = hash.Get(wd);
+  if (!w) {
+     w = new cRecordingsWatch(wd, DirName);
+     watches.Add(w);
+     hash.Add(w, wd);
+     }
+  else if (strcmp(w->path, DirName) != 0) { // the directory has been moved
+     free(w->path);
+     w->path = strdup(DirName);
+     }
+}
+
+cString cRecordingsWatcher::GetPath(int Wd)
+{
+  cMutexLock MutexLock(&mutex);
+  cRecordingsWatch *w = hash.Get(Wd);
+  return w ? w->path : NULL;
+}
+
+void cRecordingsWatcher::Forget(const char *Path)
+{
+  int l = strlen(Path);
+  // Remove the recordings in Path:
+  {
+    cThreadLock RecordingsLock(recordings);
+    for (cRecording *recording = recordings->First(); recording; ) {
+        cRecording *r = recording;
+        recording = recordings->Next(recording);
+        const char *FileName = r->FileName();
+        if (strncmp(FileName, Path, l) == 0 && (FileName[l] == '/' || !FileName[l])) {
+           int n = strlen(FileName) - strlen(RECEXT);
+           if (access(cString::sprintf("%.*s%s", n, FileName, DELEXT), F_OK) == 0)
+              recordings->DelByName(FileName, false); // it has been deleted by somebody else
+           else {
+              // same as in cRecordings::ScanVideoDir():
+              recordings->Del(r, false);
+              VanishedRecordings.Add(r);
+              recordings->ChangeState();
+              }
+           }
+        }
+  }
+  // Stop watching the directories in Path:
+  cMutexLock MutexLock(&mutex);
+  for (cRecordingsWatch *watch = watches.First(); watch; ) {
+      cRecordingsWatch *w = watch;
+      watch = watches.Next(watch);
+      if (strncmp(w->path, Path, l) == 0 && (w->path[l] == '/' || !w->path[l])) {
+         inotify_rm_watch(fd, w->wd);
+         hash.Del(w, w->wd);
+         watches.Del(w);
+         }
+      }
+}
+
+void cRecordingsWatcher::Scan(const char *DirName, int LinkLevel)
+{
+  Watch(DirName);
+  cReadDir d(DirName);
+  struct dirent *e;
+  while (Running() && (e = d.Next()) != NULL) {
+        cString buffer = AddDirectory(DirName, e->d_name);
+        struct stat st;
+        if (lstat(buffer, &st) == 0) {
+           int Link = 0;
+           if (S_ISLNK(st.st_mode)) {
+              if (LinkLevel > MAX_LINK_LEVEL)
+                 continue;
+              Link = 1;
+              if (stat(buffer, &st) != 0)
+                 continue;
+              }
+           if (S_ISDIR(st.st_mode)) {
+              if (endswith(buffer, RECEXT)) {
+                 Watch(buffer);
+                 recordings->AddByName(buffer, false);
+                 }
+              else if (!endswith(buffer, DELEXT))
+                 Scan(buffer, LinkLevel + Link);
+              }
+           }
+        }
+}
+
+void cRecordingsWatcher::Process(const struct inotify_event *Event)
+{
+  if (Event->mask & IN_Q_OVERFLOW) {
+     dsyslog("recordings watcher lost events");
+     cMutexLock MutexLock(&mutex);
+     overflow = true;
+     return;
+     }
+  if (Event->mask & IN_IGNORED) { // the directory has been removed
+     cMutexLock MutexLock(&mutex);
+     if (cRecordingsWatch *w = hash.Get(Event->wd)) {
+        hash.Del(w, w->wd);
+        watches.Del(w);
+        }
+     return;
+     }
+  if (!Event->len)
+     return;
+  cString DirName = GetPath(Event->wd);
+  if (!*DirName)
+     return; // this directory is no longer watched
+  cString FileName = AddDirectory(DirName, Event->name);
+  if (Event->mask & IN_ISDIR) {
+     if (Event->mask & (IN_CREATE | IN_MOVED_TO)) {
+        if (endswith(FileName, RECEXT)) {
+           Watch(FileName);
+           recordings->AddByName(FileName, false);
+           }
+        else if (!endswith(FileName, DELEXT))
+           Scan(FileName); // a folder that has been moved here may already contain recordings
+        }
+     else if (Event->mask & (IN_DELETE | IN_MOVED_FROM))
+        Forget(FileName);
+     }
+  else if (endswith(DirName, RECEXT) && (Event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+     if (strcmp(Event->name, "info") == 0 || strcmp(Event->name, "info.vdr") == 0) {
+        recordings->UpdateByName(DirName);
+        recordings->ChangeState();
+        }
+     else if (startswith(Event->name, "resume"))
+        recordings->ResetResume(FileName);
+     }
+}
+
+void cRecordingsWatcher::Action(void)
+{
+  char Buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  cPoller Poller(fd);
+  while (Running() && Watching()) {
+        if (Poller.Poll(WATCHERTIMEOUT)) {
+           ssize_t n = safe_read(fd, Buffer, sizeof(Buffer));
+           if (n < 0) {
+              if (errno != EAGAIN)
+                 LOG_ERROR;
+              continue;
+              }
+           for (char *p = Buffer; p < Buffer + n; ) {
+               const struct inotify_event *Event = (const struct inotify_event *)p;
+               Process(Event);
+               p += sizeof(struct inotify_event) + Event->len;
+               }
+           }
+        }
+}
+
+// --- cRecordingsScanner ----------------------------------------------------
+
+#define RSC_MAXWORKERS  8 // max. number of directories that are examined in parallel
+#define RSC_JOBWAIT   100 // ms to wait for a worker to finish a directory
+
+// Folders and recordings are examined by a pool of workers, so that the
+// latency of the storage (which may well be on the network) is spread over
+// several requests in flight. Any folder a worker finds is queued as a new job,
+// and the recordings are collected and added to the list all at once.
+
+class cRecordingsScannerJob : public cListObject {
+public:
+  char *fileName;
+  time_t modified;
+  bool recording;
+  bool link;
+  int linkLevel;
+  cRecordingsScannerJob(const char *FileName, time_t Modified, bool Recording, bool Link, int LinkLevel);
+  virtual ~cRecordingsScannerJob();
+  };
+
+cRecordingsScannerJob::cRecordingsScannerJob(const char *FileName, time_t Modified, bool Recording, bool Link, int LinkLevel)
+{
+  fileName = strdup(FileName);
+  modified = Modified;
+  recording = Recording;
+  link = Link;
+  linkLevel = LinkLevel;
+}
+
+cRecordingsScannerJob::~cRecordingsScannerJob()
+{
+  free(fileName);
+}
+
+class cRecordingsScanner {
+  friend class cRecordingsScannerWorker;
+private:
+  cRecordings *recordings;
+  bool foreground;
+  cMutex mutex;
+  cCondVar jobAdded;
+  cCondVar jobDone;
+  cList<cRecordingsScannerJob> jobs;
+  int busy; // the number of jobs currently being processed
+  cList<cRecording> found;
+  bool Running(void) { return foreground || recordings->Running(); }
+  void AddJob(cRecordingsScannerJob *Job);
+  cRecordingsScannerJob *GetJob(void);
+  void JobDone(cRecordingsScannerJob *Job);
+  void ScanFolder(cRecordingsScannerJob *Job);
+  void ScanRecording(cRecordingsScannerJob *Job);
+public:
+  cRecordingsScanner(cRecordings *Recordings, bool Foreground);
+  ~cRecordingsScanner();
+  bool Scan(const char *DirName);
+       ///< Scans the given directory and all of its sub directories for recordings
+       ///< and adds any new ones to the list. Returns true if any were added.
+  };
+
+class cRecordingsScannerWorker : public cThread {
+private:
+  cRecordingsScanner *scanner;
+protected:
+  virtual void Action(void);
+public:
+  cRecordingsScannerWorker(cRecordingsScanner *Scanner);
+  ~cRecordingsScannerWorker();
+  };
+
+cRecordingsScannerWorker::cRecordingsScannerWorker(cRecordingsScanner *Scanner)
+:cThread("video directory scanner worker")
+{
+  scanner = Scanner;
+  Start();
+}
+
+cRecordingsScannerWorker::~cRecordingsScannerWorker()
+{
+  Cancel(3);
+}
+
+void cRecordingsScannerWorker::Action(void)
+{
+  while (Running()) {
+        cRecordingsScannerJob *Job = scanner->GetJob();
+        if (!Job)
+           break;
+        if (Job->recording)
+           scanner->ScanRecording(Job);
+        else
+           scanner->ScanFolder(Job);
+        scanner->JobDone(Job);
+        }
+}
+
+cRecordingsScanner::cRecordingsScanner(cRecordings *Recordings, bool Foreground)
+{
+  recordings = Recordings;
+  foreground = Foreground;
+  busy = 0;
+}
+
+cRecordingsScanner::~cRecordingsScanner()
+{
+  jobs.Clear();
+  found.Clear();
+}
+
+void cRecordingsScanner::AddJob(cRecordingsScannerJob *Job)
+{
+  cMutexLock MutexLock(&mutex);
+  jobs.Add(Job);
+  jobAdded.Broadcast();
+}
+
+cRecordingsScannerJob *cRecordingsScanner::GetJob(void)
+{
+  cMutexLock MutexLock(&mutex);
+  while (!jobs.First()) {
+        if (!busy || !Running())
+           return NULL; // all jobs are done
+        jobAdded.TimedWait(mutex, RSC_JOBWAIT);
+        }
+  cRecordingsScannerJob *Job = jobs.First();
+  jobs.Del(Job, false);
+  busy++;
+  return Job;
+}
+
+void cRecordingsScanner::JobDone(cRecordingsScannerJob *Job)
+{
+  delete Job;
+  cMutexLock MutexLock(&mutex);
+  busy--;
+  jobAdded.Broadcast(); // lets idle workers end if this was the last job
+  jobDone.Broadcast();
+}
+
+void cRecordingsScanner::ScanFolder(cRecordingsScannerJob *Job)
+{
+  const char *DirName = Job->fileName;
+  cRecordingsWatcher *Watcher = recordings->watcher;
+  cRecordingsCatalog *Catalog = recordings->catalog;
+  if (Watcher)
+     Watcher->Watch(DirName);
+  // Take the directory's contents from the catalog if it hasn't changed:
+  const cRecordingsCatalogEntry *Folder = Catalog ? Catalog->Get(DirName, Job->modified) : NULL;
+  cReadDir *d = Folder ? NULL : new cReadDir(DirName);
+  for (int i = 0; Running(); i++) {
+      cString buffer;
+      struct stat st;
+      int Link = 0;
+      if (Folder) {
+         if (i >= Folder->children.Size())
+            break;
+         const cRecordingsCatalogEntry *Child = Folder->children[i];
+         buffer = AddDirectory(DirName, Child->BaseName());
+         if (Child->link) {
+            if (Job->linkLevel > MAX_LINK_LEVEL)
+               continue;
+            Link = 1;
+            }
+         if (stat(buffer, &st) != 0)
+            continue;
+         }
+      else {
+         struct dirent *e = d->Next();
+         if (!e)
+            break;
+         buffer = AddDirectory(DirName, e->d_name);
+         if (lstat(buffer, &st) != 0)
+            continue;
+         if (S_ISLNK(st.st_mode)) {
+            if (Job->linkLevel > MAX_LINK_LEVEL) {
+               isyslog("max link level exceeded - not scanning %s", *buffer);
+               continue;
+               }
+            Link = 1;
+            if (stat(buffer, &st) != 0)
+               continue;
+            }
+         }
+      if (S_ISDIR(st.st_mode)) {
+         if (endswith(buffer, recordings->deleted ? DELEXT : RECEXT))
+            AddJob(new cRecordingsScannerJob(buffer, st.st_mtime, true, Link, Job->linkLevel));
+         else {
+            if (Catalog)
+               Catalog->Add(buffer, st.st_mtime, false, Link);
+            AddJob(new cRecordingsScannerJob(buffer, st.st_mtime, false, Link, Job->linkLevel + Link));
+            }
+         }
+      }
+  delete d;
+}
+
+void cRecordingsScanner::ScanRecording(cRecordingsScannerJob *Job)
+{
+  const char *FileName = Job->fileName;
+  cRecordingsCatalog *Catalog = recordings->catalog;
+  if (recordings->watcher)
+     recordings->watcher->Watch(FileName);
+  if (recordings->deleted || recordings->initial || !recordings->GetByName(FileName)) {
+     const cRecordingsCatalogEntry *Entry = Catalog ? Catalog->Get(FileName, Job->modified) : NULL;
+     cRecording *r = Entry && Entry->info ? new cRecording(FileName, Entry->info) : new cRecording(FileName);
+     if (r->Name()) {
+        if (Entry && Entry->info) {
+           r->numFrames = Entry->numFrames;
+           r->fileSizeMB = Entry->fileSizeMB;
+           r->isOnVideoDirectoryFileSystem = Entry->isOnVideoDirectoryFileSystem;
+           }
+        r->NumFrames(); // initializes the numFrames member
+        r->FileSizeMB(); // initializes the fileSizeMB member
+        r->IsOnVideoDirectoryFileSystem(); // initializes the isOnVideoDirectoryFileSystem member
+        if (recordings->deleted)
+           r->deleted = time(NULL);
+        cMutexLock MutexLock(&mutex);
+        found.Add(r);
+        }
+     else
+        delete r;
+     if (Catalog)
+        Catalog->Add(FileName, Job->modified, true, Job->link);
+     }
+  else if (Catalog) // the recording in the list may not reflect what's on disk if its directory has changed:
+     Catalog->Add(FileName, Catalog->Get(FileName, Job->modified) ? Job->modified : 0, true, Job->link);
+}
+
+bool cRecordingsScanner::Scan(const char *DirName)
+{
+  time_t Modified = 0;
+  if (recordings->catalog) {
+     struct stat st;
+     if (stat(DirName, &st) == 0)
+        Modified = st.st_mtime;
+     recordings->catalog->Add(DirName, Modified, false, false);
+     }
+  AddJob(new cRecordingsScannerJob(DirName, Modified, false, false, 0));
+  cVideoDirectory::IsOnVideoDirectoryFileSystem(DirName); // makes sure the video directory object exists before the workers use it
+  cVector<cRecordingsScannerWorker *> Workers;
+  for (int i = 0; i < RSC_MAXWORKERS; i++)
+      Workers.Append(new cRecordingsScannerWorker(this));
+  mutex.Lock();
+  while (Running() && (jobs.First() || busy))
+        jobDone.TimedWait(mutex, RSC_JOBWAIT);
+  mutex.Unlock();
+  for (int i = 0; i < Workers.Size(); i++)
+      delete Workers[i];
+  // Add the new recordings to the list (the workers checked whether they are
+  // already in there without holding the lock, so the watcher may have added
+  // some of them in the meantime):
+  bool Result = found.Count() > 0;
+  recordings->Lock();
+  cHash<cRecording> ByName(RECCATALOGHASHSIZE);
+  for (cRecording *r = recordings->First(); r; r = recordings->Next(r))
+      ByName.Add(r, cRecordingsCatalog::Hash(r->FileName()));
+  while (cRecording *r = found.First()) {
+        found.Del(r, false);
+        bool Listed = false;
+        if (cList<cHashObject> *list = ByName.GetList(cRecordingsCatalog::Hash(r->FileName()))) {
+           for (cHashObject *hob = list->First(); hob; hob = list->Next(hob)) {
+               if (strcmp(((cRecording *)hob->Object())->FileName(), r->FileName()) == 0) {
+                  Listed = true;
+                  break;
+                  }
+               }
+           }
+        if (Listed)
+           delete r;
+        else
+           recordings->Add(r);
+        }
+  recordings->Unlock();
+  return Result;
+}
+
 // --- cRecordings -----------------------------------------------------------
 
 cRecordings Recordings;
@@ -1373,11 +2272,15 @@ cRecordings::cRecordings(bool Deleted)
   initial = true;
   lastUpdate = 0;
   state = 0;
+  catalog = NULL;
+  watcher = NULL;
 }
 
 cRecordings::~cRecordings()
 {
   Cancel(3);
+  delete watcher;
+  delete catalog;
 }
 
 void cRecordings::Action(void)
@@ -1392,6 +2295,12 @@ const char *cRecordings::UpdateFileName(void)
   return updateFileName;
 }
 
+void cRecordings::SetCatalogFileName(const char *FileName)
+{
+  delete catalog;
+  catalog = FileName ? new cRecordingsCatalog(FileName) : NULL;
+}
+
 void cRecordings::Refresh(bool Foreground)
 {
   lastUpdate = time(NULL); // doing this first to make sure we don't miss anything
@@ -1402,58 +2311,24 @@ void cRecordings::Refresh(bool Foreground)
      ChangeState();
      Unlock();
      }
+  if (!deleted && !watcher)
+     watcher = new cRecordingsWatcher(this);
+  if (catalog)
+     catalog->Begin(lastUpdate);
   ScanVideoDir(cVideoDirectory::Name(), Foreground);
+  if (catalog)
+     catalog->End(this, Foreground || Running());
+  if (watcher && watcher->Watching())
+     watcher->Start(); // the events that occurred during the scan are processed now
 }
 
-bool cRecordings::ScanVideoDir(const char *DirName, bool Foreground, int LinkLevel, int DirLevel)
+bool cRecordings::ScanVideoDir(const char *DirName, bool Foreground)
 {
-  bool DoChangeState = false;
   // Find any new recordings:
-  cReadDir d(DirName);
-  struct dirent *e;
-  while ((Foreground || Running()) && (e = d.Next()) != NULL) {
-        cString buffer = AddDirectory(DirName, e->d_name);
-        struct stat st;
-        if (lstat(buffer, &st) == 0) {
-           int Link = 0;
-           if (S_ISLNK(st.st_mode)) {
-              if (LinkLevel > MAX_LINK_LEVEL) {
-                 isyslog("max link level exceeded - not scanning %s", *buffer);
-                 continue;
-                 }
-              Link = 1;
-              if (stat(buffer, &st) != 0)
-                 continue;
-              }
-           if (S_ISDIR(st.st_mode)) {
-              if (endswith(buffer, deleted ? DELEXT : RECEXT)) {
-                 if (deleted || initial || !GetByName(buffer)) {
-                    cRecording *r = new cRecording(buffer);
-                    if (r->Name()) {
-                       r->NumFrames(); // initializes the numFrames member
-                       r->FileSizeMB(); // initializes the fileSizeMB member
-                       r->IsOnVideoDirectoryFileSystem(); // initializes the isOnVideoDirectoryFileSystem member
-                       if (deleted)
-                          r->deleted = time(NULL);
-                       Lock();
-                       Add(r);
-                       if (initial)
-                          ChangeState();
-                       else
-                          DoChangeState = true;
-                       Unlock();
-                       }
-                    else
-                       delete r;
-                    }
-                 }
-              else
-                 DoChangeState |= ScanVideoDir(buffer, Foreground, LinkLevel + Link, DirLevel + 1);
-              }
-           }
-        }
+  cRecordingsScanner Scanner(this, Foreground);
+  bool DoChangeState = Scanner.Scan(DirName);
   // Handle any vanished recordings:
-  if (!deleted && !initial && DirLevel == 0) {
+  if (!deleted && !initial) {
      for (cRecording *recording = First(); recording; ) {
          cRecording *r = recording;
          recording = Next(recording);
@@ -1466,7 +2341,7 @@ bool cRecordings::ScanVideoDir(const char *DirName, bool Foreground, int LinkLev
             }
          }
      }
-  if (DoChangeState && DirLevel == 0)
+  if (DoChangeState)
      ChangeState();
   return DoChangeState;
 }
@@ -1489,6 +2364,10 @@ void cRecordings::TouchUpdate(void)
 
 bool cRecordings::NeedsUpdate(void)
 {
+  if (watcher && watcher->Watching() && watcher->Overflow())
+     return true;
+  // The watcher only sees changes made on this host, but the video directory may
+  // also be modified by other hosts (via NFS or CIFS), which touch '.update':
   time_t lastModified = LastModifiedTime(UpdateFileName());
   if (lastModified > time(NULL))
      return false; // somebody's clock isn't running correctly
@@ -1531,7 +2410,7 @@ void cRecordings::AddByName(const char *FileName, bool TriggerUpdate)
      }
 }
 
-void cRecordings::DelByName(const char *FileName)
+void cRecordings::DelByName(const char *FileName, bool TriggerUpdate)
 {
   LOCK_THREAD;
   cRecording *recording = GetByName(FileName);
@@ -1544,7 +2423,7 @@ void cRecordings::DelByName(const char *FileName)
   char *ext = strrchr(recording->fileName, '.');
   if (ext) {
      strncpy(ext, DELEXT, strlen(ext));
-     if (access(recording->FileName(), F_OK) == 0) {
+     if (access(recording->FileName(), F_OK) == 0 && !DeletedRecordings.GetByName(recording->FileName())) {
         recording->deleted = time(NULL);
         DeletedRecordings.Add(recording);
         recording = NULL; // to prevent it from being deleted below
@@ -1552,7 +2431,8 @@ void cRecordings::DelByName(const char *FileName)
      }
   delete recording;
   ChangeState();
-  TouchUpdate();
+  if (TriggerUpdate)
+     TouchUpdate();
 }
 
 void cRecordings::UpdateByName(const char *FileName)
@@ -1654,21 +2534,52 @@ void cRecordings::ClearSortNames(void)
       recording->ClearSortName();
 }
 
-// --- cDirCopier ------------------------------------------------------------
-
+// --- cDirCopier ------------------------------------------------------------
+
+#define DIRCOPIERCHUNKSIZE  MEGABYTE(8)  // the maximum amount of data copied in one go
+#define DIRCOPIERSYNCSIZE   MEGABYTE(64) // the amount of written data after which we wait for it to hit the disk
+#define DIRCOPIERMINCHUNK   KILOBYTE(64) // the minimum chunk size when the copy rate is limited
+
+static ssize_t CopyFileRange(int FdIn, int FdOut, size_t Size)
+{
+#ifdef __NR_copy_file_range
+  return syscall(__NR_copy_file_range, FdIn, NULL, FdOut, NULL, Size, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
 class cDirCopier : public cThread {
 private:
+  enum eCopyMode { cmCopyFileRange, cmSendFile, cmReadWrite };
   cString dirNameSrc;
   cString dirNameDst;
   bool error;
   bool suspensionLogged;
+  eCopyMode copyMode;
+  uchar *buffer;
+  off_t bytesTotal;
+  off_t bytesCopied;
+  off_t fileSize;
+  off_t fileOffset;
+  off_t fileSynced;
+  cTimeMs paceTimer;
+  off_t paceBytes;
+  int paceRate;
   bool Throttled(void);
+  size_t ChunkSize(void);
+  ssize_t CopyChunk(int From, int To, size_t Size, const char *FileNameSrc, const char *FileNameDst);
+  void Flush(int From, int To, ssize_t Bytes);
+  void Pace(ssize_t Bytes);
   virtual void Action(void);
 public:
   cDirCopier(const char *DirNameSrc, const char *DirNameDst);
   virtual ~cDirCopier();
   void Stop(void);
   bool Error(void) { return error; }
+  int Progress(void);
+       ///< Returns the percentage of the data that has been copied so far.
   };
 
 cDirCopier::cDirCopier(const char *DirNameSrc, const char *DirNameDst)
@@ -1678,11 +2589,21 @@ cDirCopier::cDirCopier(const char *DirNameSrc, const char *DirNameDst)
   dirNameDst = DirNameDst;
   error = true; // prepare for the worst!
   suspensionLogged = false;
+  copyMode = cmCopyFileRange;
+  buffer = NULL;
+  bytesTotal = 0;
+  bytesCopied = 0;
+  fileSize = 0;
+  fileOffset = 0;
+  fileSynced = 0;
+  paceBytes = 0;
+  paceRate = -1;
 }
 
 cDirCopier::~cDirCopier()
 {
   Stop();
+  free(buffer);
 }
 
 bool cDirCopier::Throttled(void)
@@ -1697,24 +2618,135 @@ bool cDirCopier::Throttled(void)
   else if (suspensionLogged) {
      dsyslog("resuming copy thread");
      suspensionLogged = false;
+     paceRate = -1; // don't try to make up for the time we were suspended
      }
   return false;
 }
 
+int cDirCopier::Progress(void)
+{
+  off_t Total = bytesTotal;
+  off_t Copied = bytesCopied;
+  if (Total > 0)
+     return min(int(Copied * 100 / Total), 100);
+  return 0;
+}
+
+size_t cDirCopier::ChunkSize(void)
+{
+  // When the copy rate is limited we copy in smaller chunks, so that the pacing is smooth:
+  if (Setup.MaxCopyRate > 0)
+     return constrain(size_t(MEGABYTE(Setup.MaxCopyRate) / 10), size_t(DIRCOPIERMINCHUNK), size_t(DIRCOPIERCHUNKSIZE));
+  return DIRCOPIERCHUNKSIZE;
+}
+
+ssize_t cDirCopier::CopyChunk(int From, int To, size_t Size, const char *FileNameSrc, const char *FileNameDst)
+{
+  for (;;) {
+      switch (copyMode) {
+        case cmCopyFileRange: {
+             // Lets the kernel copy the data (or even share it, on file systems that support reflinks):
+             ssize_t Copied = CopyFileRange(From, To, Size);
+             if (Copied > 0 || Copied == 0 && fileOffset >= fileSize)
+                return Copied;
+             if (Copied == 0 || errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP) {
+                dsyslog("copy_file_range() not usable for '%s', falling back to sendfile()", FileNameDst);
+                copyMode = cmSendFile;
+                continue;
+                }
+             esyslog("ERROR: can't copy '%s' to '%s': %m", FileNameSrc, FileNameDst);
+             return -1;
+             }
+        case cmSendFile: {
+             // Copies the data inside the kernel, without passing it through user space:
+             ssize_t Copied = sendfile(To, From, NULL, Size);
+             if (Copied >= 0)
+                return Copied;
+             if (errno == ENOSYS || errno == EINVAL) {
+                dsyslog("sendfile() not usable for '%s', falling back to read()/write()", FileNameDst);
+                copyMode = cmReadWrite;
+                continue;
+                }
+             esyslog("ERROR: can't copy '%s' to '%s': %m", FileNameSrc, FileNameDst);
+             return -1;
+             }
+        case cmReadWrite: {
+             if (!buffer) {
+                void *p = NULL;
+                if (posix_memalign(&p, getpagesize(), DIRCOPIERCHUNKSIZE)) {
+                   esyslog("ERROR: can't allocate copy buffer");
+                   return -1;
+                   }
+                buffer = (uchar *)p;
+                }
+             // Have the kernel read the next chunk while we're writing this one:
+             posix_fadvise(From, fileOffset + Size, Size, POSIX_FADV_WILLNEED);
+             ssize_t Read = safe_read(From, buffer, Size);
+             if (Read > 0) {
+                ssize_t Written = safe_write(To, buffer, Read);
+                if (Written != Read) {
+                   esyslog("ERROR: can't write to destination file '%s': %m", FileNameDst);
+                   return -1;
+                   }
+                }
+             else if (Read < 0)
+                esyslog("ERROR: can't read from source file '%s': %m", FileNameSrc);
+             return Read;
+             }
+        }
+      }
+}
+
+void cDirCopier::Flush(int From, int To, ssize_t Bytes)
+{
+  off_t Offset = fileOffset - Bytes;
+  // We won't need the source data again:
+  posix_fadvise(From, Offset, Bytes, POSIX_FADV_DONTNEED);
+  // Have the destination data written to disk right away...
+  sync_file_range(To, Offset, Bytes, SYNC_FILE_RANGE_WRITE);
+  // ...and drop what has been written before from the page cache:
+  if (Offset - fileSynced >= DIRCOPIERSYNCSIZE) {
+     sync_file_range(To, fileSynced, Offset - fileSynced, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+     posix_fadvise(To, fileSynced, Offset - fileSynced, POSIX_FADV_DONTNEED);
+     fileSynced = Offset;
+     }
+}
+
+void cDirCopier::Pace(ssize_t Bytes)
+{
+  int Rate = Setup.MaxCopyRate;
+  if (Rate != paceRate) {
+     // The limit has been changed (or we're just starting), so let's begin a new measurement:
+     paceRate = Rate;
+     paceBytes = 0;
+     paceTimer.Set();
+     }
+  if (Rate > 0) {
+     paceBytes += Bytes;
+     uint64_t Due = paceBytes * 1000 / MEGABYTE(Rate); // the time this should have taken at the given rate
+     while (Running()) {
+           uint64_t Elapsed = paceTimer.Elapsed();
+           if (Elapsed >= Due)
+              break;
+           cCondWait::SleepMs(min(int(Due - Elapsed), 100));
+           }
+     }
+}
+
 void cDirCopier::Action(void)
 {
   if (DirectoryOk(dirNameDst, true)) {
      cReadDir d(dirNameSrc);
      if (d.Ok()) {
         dsyslog("copying directory '%s' to '%s'", *dirNameSrc, *dirNameDst);
+        bytesTotal = MEGABYTE(max(DirSizeMB(dirNameSrc), 0));
         dirent *e = NULL;
         cString FileNameSrc;
         cString FileNameDst;
         int From = -1;
         int To = -1;
-        size_t BufferSize = BUFSIZ;
         while (Running()) {
-              // Suspend cutting if we have severe throughput problems:
+              // Suspend copying if we have severe throughput problems:
               if (Throttled()) {
                  cCondWait::SleepMs(100);
                  continue;
@@ -1722,21 +2754,20 @@ void cDirCopier::Action(void)
               // Copy all files in the source directory to the destination directory:
               if (e) {
                  // We're currently copying a file:
-                 uchar Buffer[BufferSize];
-                 size_t Read = safe_read(From, Buffer, sizeof(Buffer));
-                 if (Read > 0) {
-                    size_t Written = safe_write(To, Buffer, Read);
-                    if (Written != Read) {
-                       esyslog("ERROR: can't write to destination file '%s': %m", *FileNameDst);
-                       break;
-                       }
+                 ssize_t Copied = CopyChunk(From, To, ChunkSize(), FileNameSrc, FileNameDst);
+                 if (Copied > 0) {
+                    fileOffset += Copied;
+                    bytesCopied += Copied;
+                    Flush(From, To, Copied);
+                    Pace(Copied);
                     }
-                 else if (Read == 0) { // EOF on From
+                 else if (Copied == 0) { // EOF on From
                     e = NULL; // triggers switch to next entry
                     if (fsync(To) < 0) {
                        esyslog("ERROR: can't sync destination file '%s': %m", *FileNameDst);
                        break;
                        }
+                    posix_fadvise(To, 0, 0, POSIX_FADV_DONTNEED);
                     if (close(From) < 0) {
                        esyslog("ERROR: can't close source file '%s': %m", *FileNameSrc);
                        break;
@@ -1753,10 +2784,8 @@ void cDirCopier::Action(void)
                        break;
                        }
                     }
-                 else {
-                    esyslog("ERROR: can't read from source file '%s': %m", *FileNameSrc);
+                 else
                     break;
-                    }
                  }
               else if ((e = d.Next()) != NULL) {
                  // We're switching to the next directory entry:
@@ -1772,7 +2801,9 @@ void cDirCopier::Action(void)
                     break;
                     }
                  dsyslog("copying file '%s' to '%s'", *FileNameSrc, *FileNameDst);
-                 BufferSize = max(size_t(st.st_blksize * 10), size_t(BUFSIZ));
+                 fileSize = st.st_size;
+                 fileOffset = 0;
+                 fileSynced = 0;
                  if (access(FileNameDst, F_OK) == 0) {
                     esyslog("ERROR: destination file '%s' already exists", *FileNameDst);
                     break;
@@ -1781,6 +2812,7 @@ void cDirCopier::Action(void)
                     esyslog("ERROR: can't open source file '%s': %m", *FileNameSrc);
                     break;
                     }
+                 posix_fadvise(From, 0, 0, POSIX_FADV_SEQUENTIAL);
                  if ((To = open(FileNameDst, O_WRONLY | O_CREAT | O_EXCL, DEFFILEMODE)) < 0) {
                     esyslog("ERROR: can't open destination file '%s': %m", *FileNameDst);
                     close(From);
@@ -1790,6 +2822,7 @@ void cDirCopier::Action(void)
               else {
                  // We're done:
                  dsyslog("done copying directory '%s' to '%s'", *dirNameSrc, *dirNameDst);
+                 bytesCopied = bytesTotal;
                  error = false;
                  return;
                  }
@@ -1832,6 +2865,7 @@ public:
   const char *FileNameSrc(void) const { return fileNameSrc; }
   const char *FileNameDst(void) const { return fileNameDst; }
   bool Active(bool &Error);
+  int Progress(void) { return copier ? copier->Progress() : -1; }
   };
 
 cRecordingsHandlerEntry::cRecordingsHandlerEntry(int Usage, const char *FileNameSrc, const char *FileNameDst)
@@ -1978,12 +3012,36 @@ void cRecordingsHandler::DelAll(void)
   Recordings.ChangeState();
 }
 
+void cRecordingsHandler::SetIndexing(const char *FileName, bool On)
+{
+  cMutexLock MutexLock(&mutex);
+  int i = indexing.Find(FileName);
+  if (On && i < 0)
+     indexing.Append(strdup(FileName));
+  else if (!On && i >= 0) {
+     free(indexing[i]);
+     indexing.Remove(i);
+     }
+  Recordings.ChangeState();
+}
+
 int cRecordingsHandler::GetUsage(const char *FileName)
+{
+  cMutexLock MutexLock(&mutex);
+  int Usage = ruNone;
+  if (cRecordingsHandlerEntry *r = Get(FileName))
+     Usage |= r->Usage(FileName);
+  if (indexing.Find(FileName) >= 0)
+     Usage |= ruIndex;
+  return Usage;
+}
+
+int cRecordingsHandler::GetProgress(const char *FileName)
 {
   cMutexLock MutexLock(&mutex);
   if (cRecordingsHandlerEntry *r = Get(FileName))
-     return r->Usage(FileName);
-  return ruNone;
+     return r->Progress();
+  return -1;
 }
 
 bool cRecordingsHandler::Active(void)
@@ -2244,11 +3302,51 @@ void cRecordingUserCommand::InvokeCommand(const char *State, const char *Recordi
 // --- cIndexFileGenerator ---------------------------------------------------
 
 #define IFG_BUFFER_SIZE KILOBYTE(100)
+#define IFG_MAXWORKERS  4 // max. number of TS files that are processed in parallel
+#define IFG_JOBWAIT   100 // ms to wait for a worker to finish a file
+
+// Each TS file of a recording starts with a PAT/PMT and an I-frame, so the
+// files can be analyzed independently of each other and the resulting frames
+// can simply be written to the index in the order of the files.
+
+class cIndexFileGeneratorJob : public cListObject {
+public:
+  uint16_t fileNumber;
+  off_t fileOffset;
+  bool skipFirst;
+  bool exists;   // the file exists
+  bool ok;       // the file has been processed completely
+  bool finished; // the worker is done with this job
+  double framesPerSecond;
+  cVector<off_t> frames; // offset << 1 | independent
+  cIndexFileGeneratorJob(uint16_t FileNumber, off_t FileOffset, bool SkipFirst);
+  };
+
+cIndexFileGeneratorJob::cIndexFileGeneratorJob(uint16_t FileNumber, off_t FileOffset, bool SkipFirst)
+{
+  fileNumber = FileNumber;
+  fileOffset = FileOffset;
+  skipFirst = SkipFirst;
+  exists = false;
+  ok = false;
+  finished = false;
+  framesPerSecond = 0;
+}
 
 class cIndexFileGenerator : public cThread {
+  friend class cIndexFileGeneratorWorker;
 private:
   cString recordingName;
   bool update;
+  cMutex mutex;
+  cCondVar jobDone;
+  cList<cIndexFileGeneratorJob> jobs;
+  uint16_t nextFileNumber;
+  off_t nextFileOffset;
+  bool skipFirst;
+  bool noMoreFiles;
+  cIndexFileGeneratorJob *GetJob(void);
+  void JobDone(cIndexFileGeneratorJob *Job);
 protected:
   virtual void Action(void);
 public:
@@ -2256,57 +3354,61 @@ public:
   ~cIndexFileGenerator();
   };
 
-cIndexFileGenerator::cIndexFileGenerator(const char *RecordingName, bool Update)
-:cThread("index file generator")
-,recordingName(RecordingName)
+class cIndexFileGeneratorWorker : public cThread {
+private:
+  cIndexFileGenerator *generator;
+  void Process(cIndexFileGeneratorJob *Job);
+protected:
+  virtual void Action(void);
+public:
+  cIndexFileGeneratorWorker(cIndexFileGenerator *Generator);
+  ~cIndexFileGeneratorWorker();
+  };
+
+cIndexFileGeneratorWorker::cIndexFileGeneratorWorker(cIndexFileGenerator *Generator)
+:cThread("index file generator worker")
 {
-  update = Update;
+  generator = Generator;
   Start();
 }
 
-cIndexFileGenerator::~cIndexFileGenerator()
+cIndexFileGeneratorWorker::~cIndexFileGeneratorWorker()
 {
   Cancel(3);
 }
 
-void cIndexFileGenerator::Action(void)
+void cIndexFileGeneratorWorker::Action(void)
 {
-  bool IndexFileComplete = false;
-  bool IndexFileWritten = false;
-  bool Rewind = false;
-  cFileName FileName(recordingName, false);
-  cUnbufferedFile *ReplayFile = FileName.Open();
+  while (Running()) {
+        cIndexFileGeneratorJob *Job = generator->GetJob();
+        if (!Job)
+           break;
+        Process(Job);
+        generator->JobDone(Job);
+        }
+}
+
+void cIndexFileGeneratorWorker::Process(cIndexFileGeneratorJob *Job)
+{
+  bool Rewind = true;
+  cFileName FileName(generator->recordingName, false);
+  cUnbufferedFile *ReplayFile = NULL;
   cRingBufferLinear Buffer(IFG_BUFFER_SIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE);
   cPatPmtParser PatPmtParser;
   cFrameDetector FrameDetector;
-  cIndexFile IndexFile(recordingName, true, false, false, true);
   int BufferChunks = KILOBYTE(1); // no need to read a lot at the beginning when parsing PAT/PMT
   off_t FileSize = 0;
   off_t FrameOffset = -1;
-  uint16_t FileNumber = 1;
-  off_t FileOffset = 0;
-  int Last = -1;
-  if (update) {
-     // Look for current index and position to end of it if present:
-     bool Independent;
-     int Length;
-     Last = IndexFile.Last();
-     if (Last >= 0 && !IndexFile.Get(Last, &FileNumber, &FileOffset, &Independent, &Length))
-        Last = -1; // reset Last if an error occurred
-     if (Last >= 0) {
-        Rewind = true;
-        isyslog("updating index file");
-        }
-     else
-        isyslog("generating index file");
-     }
-  Skins.QueueMessage(mtInfo, tr("Regenerating index file"));
+  bool SkipFrame = Job->skipFirst;
   bool Stuffed = false;
   while (Running()) {
         // Rewind input file:
         if (Rewind) {
-           ReplayFile = FileName.SetOffset(FileNumber, FileOffset);
-           FileSize = FileOffset;
+           ReplayFile = FileName.SetOffset(Job->fileNumber, Job->fileOffset);
+           if (!ReplayFile)
+              break;
+           Job->exists = true;
+           FileSize = Job->fileOffset;
            Buffer.Clear();
            Rewind = false;
            }
@@ -2321,10 +3423,10 @@ void cIndexFileGenerator::Action(void)
               int Processed = FrameDetector.Analyze(Data, Length);
               if (Processed > 0) {
                  if (FrameDetector.NewFrame()) {
-                    if (IndexFileWritten || Last < 0) // check for first frame and do not write if in update mode
-                       IndexFile.Write(FrameDetector.IndependentFrame(), FileName.Number(), FrameOffset >= 0 ? FrameOffset : FileSize);
+                    if (!SkipFrame) // in update mode the first frame is already in the index
+                       Job->frames.Append((FrameOffset >= 0 ? FrameOffset : FileSize) << 1 | FrameDetector.IndependentFrame());
                     FrameOffset = -1;
-                    IndexFileWritten = true;
+                    SkipFrame = false;
                     }
                  FileSize += Processed;
                  Buffer.Del(Processed);
@@ -2364,7 +3466,7 @@ void cIndexFileGenerator::Action(void)
               }
            }
         // Read data:
-        else if (ReplayFile) {
+        else {
            int Result = Buffer.Read(ReplayFile, BufferChunks);
            if (Result == 0) { // EOF
               if (Buffer.Available() > 0 && !Stuffed) {
@@ -2380,26 +3482,122 @@ void cIndexFileGenerator::Action(void)
                  Stuffed = true;
                  }
               else {
-                 ReplayFile = FileName.NextFile();
-                 FileSize = 0;
-                 FrameOffset = -1;
-                 Buffer.Clear();
-                 Stuffed = false;
+                 // This file has been processed:
+                 Job->framesPerSecond = FrameDetector.FramesPerSecond();
+                 Job->ok = true;
+                 break;
                  }
               }
+           else if (Result < 0) {
+              LOG_ERROR;
+              break;
+              }
            }
-        // Recording has been processed:
-        else {
+        }
+}
+
+cIndexFileGenerator::cIndexFileGenerator(const char *RecordingName, bool Update)
+:cThread("index file generator")
+,recordingName(RecordingName)
+{
+  update = Update;
+  nextFileNumber = 1;
+  nextFileOffset = 0;
+  skipFirst = false;
+  noMoreFiles = false;
+  Start();
+}
+
+cIndexFileGenerator::~cIndexFileGenerator()
+{
+  Cancel(3);
+}
+
+cIndexFileGeneratorJob *cIndexFileGenerator::GetJob(void)
+{
+  cMutexLock MutexLock(&mutex);
+  if (noMoreFiles)
+     return NULL;
+  cIndexFileGeneratorJob *Job = new cIndexFileGeneratorJob(nextFileNumber++, nextFileOffset, skipFirst);
+  nextFileOffset = 0;
+  skipFirst = false;
+  jobs.Add(Job);
+  return Job;
+}
+
+void cIndexFileGenerator::JobDone(cIndexFileGeneratorJob *Job)
+{
+  cMutexLock MutexLock(&mutex);
+  if (!Job->ok)
+     noMoreFiles = true; // no need to look at any files after a missing or broken one
+  Job->finished = true;
+  jobDone.Broadcast();
+}
+
+void cIndexFileGenerator::Action(void)
+{
+  bool IndexFileComplete = false;
+  bool IndexFileWritten = false;
+  double FramesPerSecond = 0;
+  cIndexFile IndexFile(recordingName, true, false, false, true);
+  if (update) {
+     // Look for current index and position to end of it if present:
+     bool Independent;
+     int Length;
+     int Last = IndexFile.Last();
+     if (Last >= 0 && !IndexFile.Get(Last, &nextFileNumber, &nextFileOffset, &Independent, &Length))
+        Last = -1; // reset Last if an error occurred
+     if (Last >= 0) {
+        skipFirst = true;
+        isyslog("updating index file");
+        }
+     else {
+        nextFileNumber = 1;
+        nextFileOffset = 0;
+        isyslog("generating index file");
+        }
+     }
+  Skins.QueueMessage(mtInfo, tr("Regenerating index file"));
+  RecordingsHandler.SetIndexing(recordingName, true);
+  int NumWorkers = constrain(int(sysconf(_SC_NPROCESSORS_ONLN)), 1, IFG_MAXWORKERS);
+  cVector<cIndexFileGeneratorWorker *> Workers;
+  for (int i = 0; i < NumWorkers; i++)
+      Workers.Append(new cIndexFileGeneratorWorker(this));
+  // Write the frames to the index file in the order of the TS files:
+  while (Running()) {
+        mutex.Lock();
+        cIndexFileGeneratorJob *Job = jobs.First();
+        if (!Job || !Job->finished) {
+           jobDone.TimedWait(mutex, IFG_JOBWAIT);
+           mutex.Unlock();
+           continue;
+           }
+        jobs.Del(Job, false);
+        mutex.Unlock();
+        bool Ok = Job->ok;
+        if (Ok) {
+           for (int i = 0; i < Job->frames.Size(); i++)
+               IndexFile.Write(Job->frames[i] & 1, Job->fileNumber, Job->frames[i] >> 1);
+           IndexFileWritten |= Job->frames.Size() > 0 || Job->skipFirst;
+           if (FramesPerSecond <= 0)
+              FramesPerSecond = Job->framesPerSecond;
+           }
+        else if (!Job->exists) // recording has been processed
            IndexFileComplete = true;
+        delete Job;
+        if (!Ok)
            break;
-           }
         }
+  for (int i = 0; i < Workers.Size(); i++)
+      delete Workers[i];
+  jobs.Clear();
+  RecordingsHandler.SetIndexing(recordingName, false);
   if (IndexFileComplete) {
      if (IndexFileWritten) {
         cRecordingInfo RecordingInfo(recordingName);
         if (RecordingInfo.Read()) {
-           if (FrameDetector.FramesPerSecond() > 0 && !DoubleEqual(RecordingInfo.FramesPerSecond(), FrameDetector.FramesPerSecond())) {
-              RecordingInfo.SetFramesPerSecond(FrameDetector.FramesPerSecond());
+           if (FramesPerSecond > 0 && !DoubleEqual(RecordingInfo.FramesPerSecond(), FramesPerSecond)) {
+              RecordingInfo.SetFramesPerSecond(FramesPerSecond);
               RecordingInfo.Write();
               Recordings.UpdateByName(recordingName);
               }
@@ -2446,6 +3644,7 @@ struct tIndexTs {
 #define MAXWAITFORINDEXFILE     10 // max. time to wait for the regenerated index file (seconds)
 #define INDEXFILECHECKINTERVAL 500 // ms between checks for existence of the regenerated index file
 #define INDEXFILETESTINTERVAL   10 // ms between tests for the size of the index file in case of pausing live video
+#define INDEXMAPMINSIZE       8192 // min. number of index entries to map at once
 
 cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, bool PauseLive, bool Update)
 :resumeFile(FileName, IsPesRecording)
@@ -2454,6 +3653,9 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
   size = 0;
   last = -1;
   index = NULL;
+  mappedSize = 0;
+  mappedFile = -1;
+  iFramesLast = -1;
   isPesRecording = IsPesRecording;
   indexFileGenerator = NULL;
   if (FileName) {
@@ -2488,10 +3690,11 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
            last = int((buf.st_size + delta) / sizeof(tIndexTs) - 1);
            if ((!Record || Update) && last >= 0) {
               size = last + 1;
-              index = MALLOC(tIndexTs, size);
-              if (index) {
-                 f = open(fileName, O_RDONLY);
-                 if (f >= 0) {
+              f = open(fileName, O_RDONLY);
+              if (f >= 0) {
+                 if (!Record && !isPesRecording && Map(size))
+                    ; // TS index files are used as they are, so there's nothing to read here
+                 else if ((index = MALLOC(tIndexTs, size)) != NULL) {
                     if (safe_read(f, index, size_t(buf.st_size)) != buf.st_size) {
                        esyslog("ERROR: can't read from file '%s'", *fileName);
                        free(index);
@@ -2499,17 +3702,20 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
                        }
                     else if (isPesRecording)
                        ConvertFromPes(index, size);
-                    if (!index || time(NULL) - buf.st_mtime >= MININDEXAGE) {
-                       close(f);
-                       f = -1;
-                       }
-                    // otherwise we don't close f here, see CatchUp()!
                     }
                  else
-                    LOG_ERROR_STR(*fileName);
+                    esyslog("ERROR: can't allocate %zd bytes for index '%s'", size * sizeof(tIndexTs), *fileName);
+                 if (!index || time(NULL) - buf.st_mtime >= MININDEXAGE) {
+                    if (mappedSize)
+                       mappedFile = f; // to check whether the file gets truncated
+                    else
+                       close(f);
+                    f = -1;
+                    }
+                 // otherwise we don't close f here, see CatchUp()!
                  }
               else
-                 esyslog("ERROR: can't allocate %zd bytes for index '%s'", size * sizeof(tIndexTs), *fileName);
+                 LOG_ERROR_STR(*fileName);
               }
            }
         else
@@ -2535,10 +3741,67 @@ cIndexFile::~cIndexFile()
 {
   if (f >= 0)
      close(f);
-  free(index);
+  if (mappedFile >= 0)
+     close(mappedFile);
+  if (mappedSize)
+     munmap(index, mappedSize);
+  else
+     free(index);
   delete indexFileGenerator;
 }
 
+bool cIndexFile::Map(int Size)
+{
+  // The mapping is made larger than the file, so that an index that is still
+  // being written can grow for a while without having to be remapped. Only the
+  // entries up to 'last' are ever accessed, which are inside the file unless it
+  // has been truncated (see CheckMapping()).
+  size_t PageSize = sysconf(_SC_PAGESIZE);
+  size_t Length = (max(Size * 2, INDEXMAPMINSIZE) * sizeof(tIndexTs) + PageSize - 1) & ~(PageSize - 1);
+  void *p = MAP_FAILED;
+  if (mappedSize)
+     p = mremap(index, mappedSize, Length, MREMAP_MAYMOVE);
+  else if (f >= 0)
+     p = mmap(NULL, Length, PROT_READ, MAP_SHARED, f, 0);
+  if (p == MAP_FAILED) {
+     LOG_ERROR_STR(*fileName);
+     return false;
+     }
+  index = (tIndexTs *)p;
+  mappedSize = Length;
+  size = int(Length / sizeof(tIndexTs));
+  return true;
+}
+
+void cIndexFile::CheckMapping(void)
+{
+  int fd = f >= 0 ? f : mappedFile;
+  struct stat buf;
+  if (fstat(fd, &buf) == 0 && buf.st_size >= off_t((last + 1) * sizeof(tIndexTs)))
+     return;
+  esyslog("ERROR: index file '%s' has been truncated", *fileName);
+  int Last = fstat(fd, &buf) == 0 ? int(buf.st_size / sizeof(tIndexTs)) - 1 : -1;
+  tIndexTs *Index = MALLOC(tIndexTs, max(Last + 1, 1));
+  if (Index && Last >= 0) {
+     ssize_t Size = (Last + 1) * sizeof(tIndexTs);
+     if (pread(fd, Index, Size, 0) != Size) {
+        LOG_ERROR_STR(*fileName);
+        Last = -1;
+        }
+     }
+  munmap(index, mappedSize);
+  mappedSize = 0;
+  if (mappedFile >= 0) {
+     close(mappedFile);
+     mappedFile = -1;
+     }
+  index = Index;
+  size = max(Last + 1, 1);
+  last = Last;
+  iFrames.Clear();
+  iFramesLast = -1;
+}
+
 cString cIndexFile::IndexFileName(const char *FileName, bool IsPesRecording)
 {
   return cString::sprintf("%s%s", FileName, IsPesRecording ? INDEXFILESUFFIX ".vdr" : INDEXFILESUFFIX);
@@ -2572,6 +3835,10 @@ void cIndexFile::ConvertToPes(tIndexTs *IndexTs, int Count)
 bool cIndexFile::CatchUp(int Index)
 {
   // returns true unless something really goes wrong, so that 'index' becomes NULL
+  if (mappedSize) {
+     cMutexLock MutexLock(&mutex);
+     CheckMapping();
+     }
   if (index && f >= 0) {
      cMutexLock MutexLock(&mutex);
      // Note that CatchUp() is triggered even if Index is 'last' (and thus valid).
@@ -2580,7 +3847,12 @@ bool cIndexFile::CatchUp(int Index)
          struct stat buf;
          if (fstat(f, &buf) == 0) {
             int newLast = int(buf.st_size / sizeof(tIndexTs) - 1);
-            if (newLast > last) {
+            if (newLast > last && mappedSize) {
+               if (newLast >= size && !Map(newLast + 1))
+                  break;
+               last = newLast;
+               }
+            else if (newLast > last) {
                int NewSize = size;
                if (NewSize <= newLast) {
                   NewSize *= 2;
@@ -2637,11 +3909,46 @@ bool cIndexFile::Write(bool Independent, uint16_t FileNumber, off_t FileOffset)
         f = -1;
         return false;
         }
-     last++;
+     cMutexLock MutexLock(&mutex);
+     if (iFramesLast == last++) {
+        // Keep the list of I-frames up to date if it has already been built:
+        if (Independent)
+           iFrames.Append(last);
+        iFramesLast = last;
+        }
      }
   return f >= 0;
 }
 
+void cIndexFile::UpdateIFrames(void)
+{
+  // Must be called with 'mutex' locked!
+  if (index) {
+     for (int i = iFramesLast + 1; i <= last; i++) {
+         if (index[i].independent)
+            iFrames.Append(i);
+         }
+     iFramesLast = max(iFramesLast, last);
+     }
+}
+
+int cIndexFile::FindIFrame(int Index)
+{
+  // Returns the position in 'iFrames' of the first I-frame at or after Index.
+  // Must be called with 'mutex' locked!
+  UpdateIFrames();
+  int l = 0;
+  int h = iFrames.Size();
+  while (l < h) {
+        int m = (l + h) / 2;
+        if (iFrames[m] < Index)
+           l = m + 1;
+        else
+           h = m;
+        }
+  return l;
+}
+
 bool cIndexFile::Get(int Index, uint16_t *FileNumber, off_t *FileOffset, bool *Independent, int *Length)
 {
   if (CatchUp(Index)) {
@@ -2671,37 +3978,38 @@ bool cIndexFile::Get(int Index, uint16_t *FileNumber, off_t *FileOffset, bool *I
 int cIndexFile::GetNextIFrame(int Index, bool Forward, uint16_t *FileNumber, off_t *FileOffset, int *Length)
 {
   if (CatchUp()) {
+     cMutexLock MutexLock(&mutex);
      int d = Forward ? 1 : -1;
-     for (;;) {
-         Index += d;
-         if (Index >= 0 && Index <= last) {
-            if (index[Index].independent) {
-               uint16_t fn;
-               if (!FileNumber)
-                  FileNumber = &fn;
-               off_t fo;
-               if (!FileOffset)
-                  FileOffset = &fo;
-               *FileNumber = index[Index].number;
-               *FileOffset = index[Index].offset;
-               if (Length) {
-                  if (Index < last) {
-                     uint16_t fn = index[Index + 1].number;
-                     off_t fo = index[Index + 1].offset;
-                     if (fn == *FileNumber)
-                        *Length = int(fo - *FileOffset);
-                     else
-                        *Length = -1; // this means "everything up to EOF" (the buffer's Read function will act accordingly)
-                     }
-                  else
-                     *Length = -1;
-                  }
-               return Index;
-               }
-            }
-         else
-            break;
-         }
+     Index += d;
+     if (Index >= 0 && Index <= last) {
+        int p = FindIFrame(Index);
+        if (!Forward)
+           p -= iFrames.Size() > p && iFrames[p] == Index ? 0 : 1;
+        if (p >= 0 && p < iFrames.Size()) {
+           Index = iFrames[p];
+           uint16_t fn;
+           if (!FileNumber)
+              FileNumber = &fn;
+           off_t fo;
+           if (!FileOffset)
+              FileOffset = &fo;
+           *FileNumber = index[Index].number;
+           *FileOffset = index[Index].offset;
+           if (Length) {
+              if (Index < last) {
+                 uint16_t fn = index[Index + 1].number;
+                 off_t fo = index[Index + 1].offset;
+                 if (fn == *FileNumber)
+                    *Length = int(fo - *FileOffset);
+                 else
+                    *Length = -1; // this means "everything up to EOF" (the buffer's Read function will act accordingly)
+                 }
+              else
+                 *Length = -1;
+              }
+           return Index;
+           }
+        }
      }
   return -1;
 }
@@ -2709,27 +4017,19 @@ int cIndexFile::GetNextIFrame(int Index, bool Forward, uint16_t *FileNumber, off
 int cIndexFile::GetClosestIFrame(int Index)
 {
   if (last > 0) {
+     cMutexLock MutexLock(&mutex);
+     if (mappedSize)
+        CheckMapping();
      Index = constrain(Index, 0, last);
-     if (index[Index].independent)
-        return Index;
-     int il = Index - 1;
-     int ih = Index + 1;
-     for (;;) {
-         if (il >= 0) {
-            if (index[il].independent)
-               return il;
-            il--;
-            }
-         else if (ih > last)
-            break;
-         if (ih <= last) {
-            if (index[ih].independent)
-               return ih;
-            ih++;
-            }
-         else if (il < 0)
-            break;
-         }
+     int p = FindIFrame(Index);
+     int il = p > 0 ? iFrames[p - 1] : -1;
+     int ih = p < iFrames.Size() ? iFrames[p] : -1;
+     if (ih == Index)
+        return ih;
+     if (il >= 0 && (ih < 0 || Index - il <= ih - Index))
+        return il;
+     if (ih >= 0)
+        return ih;
      }
   return 0;
 }
@@ -2737,13 +4037,16 @@ int cIndexFile::GetClosestIFrame(int Index)
 int cIndexFile::Get(uint16_t FileNumber, off_t FileOffset)
 {
   if (CatchUp()) {
-     //TODO implement binary search!
-     int i;
-     for (i = 0; i <= last; i++) {
-         if (index[i].number > FileNumber || (index[i].number == FileNumber) && off_t(index[i].offset) >= FileOffset)
-            break;
-         }
-     return i;
+     int l = 0;
+     int h = last + 1;
+     while (l < h) {
+           int m = (l + h) / 2;
+           if (index[m].number < FileNumber || index[m].number == FileNumber && off_t(index[m].offset) < FileOffset)
+              l = m + 1;
+           else
+              h = m;
+           }
+     return l;
      }
   return -1;
 }
@@ -2966,6 +4269,168 @@ cUnbufferedFile *cFileName::NextFile(void)
   return SetOffset(fileNumber + 1);
 }
 
+// --- cRecordingWriter ------------------------------------------------------
+
+#define WRITERBLOCKSIZE  int(MEGABYTE(1)) // the size of each block written to disk at once
+#define WRITERMAXBLOCKS  16 // the maximum number of blocks waiting to be written
+#define WRITERFREEBLOCKS 4 // the number of written blocks kept for reuse
+#define WRITERMAXDELAY   100 // ms after which a partially filled block is written
+
+class cRecordingWriterBlock : public cListObject {
+public:
+  uchar *data;
+  int length;
+  bool nextFile;
+  cVector<off_t> marks; // index entries in this block (offset << 1 | independent)
+  cRecordingWriterBlock(void) { data = MALLOC(uchar, WRITERBLOCKSIZE); length = 0; nextFile = false; }
+  virtual ~cRecordingWriterBlock() { free(data); }
+  };
+
+cRecordingWriter::cRecordingWriter(cFileName *FileName, cIndexFile *Index)
+:cThread("recording writer")
+{
+  fileName = FileName;
+  index = Index;
+  current = NULL;
+  pending = 0;
+  fileSize = 0;
+  error = false;
+  Start();
+}
+
+cRecordingWriter::~cRecordingWriter()
+{
+  Flush();
+  Cancel(3);
+  delete current;
+}
+
+cRecordingWriterBlock *cRecordingWriter::NewBlock(bool NextFile)
+{
+  // the caller must hold the mutex
+  Queue();
+  current = freeBlocks.First();
+  if (current)
+     freeBlocks.Del(current, false);
+  else
+     current = new cRecordingWriterBlock;
+  current->length = 0;
+  current->nextFile = NextFile;
+  current->marks.Clear();
+  currentAge.Set();
+  return current;
+}
+
+void cRecordingWriter::Queue(void)
+{
+  // the caller must hold the mutex
+  if (current) {
+     blocks.Add(current);
+     pending++;
+     current = NULL;
+     blockReady.Broadcast();
+     }
+}
+
+void cRecordingWriter::Write(const uchar *Data, int Length)
+{
+  cMutexLock MutexLock(&mutex);
+  lastActivity.Set();
+  while (Length > 0) {
+        if (!current || current->length >= WRITERBLOCKSIZE)
+           NewBlock();
+        int n = min(Length, WRITERBLOCKSIZE - current->length);
+        memcpy(current->data + current->length, Data, n);
+        current->length += n;
+        fileSize += n;
+        Data += n;
+        Length -= n;
+        }
+  if (current && (current->length >= WRITERBLOCKSIZE || currentAge.Elapsed() > WRITERMAXDELAY))
+     Queue();
+}
+
+void cRecordingWriter::WriteIndex(bool Independent)
+{
+  cMutexLock MutexLock(&mutex);
+  lastActivity.Set();
+  if (!current || current->length >= WRITERBLOCKSIZE) // the entry must be in the same block as the data it points to
+     NewBlock();
+  current->marks.Append((fileSize << 1) | Independent);
+}
+
+void cRecordingWriter::NextFile(void)
+{
+  cMutexLock MutexLock(&mutex);
+  NewBlock(true);
+  fileSize = 0;
+}
+
+bool cRecordingWriter::WaitForSpace(int TimeoutMs)
+{
+  cMutexLock MutexLock(&mutex);
+  if (pending >= WRITERMAXBLOCKS)
+     blockDone.TimedWait(mutex, TimeoutMs);
+  return pending < WRITERMAXBLOCKS;
+}
+
+bool cRecordingWriter::Flush(void)
+{
+  cMutexLock MutexLock(&mutex);
+  Queue();
+  while (pending && Active())
+        blockDone.TimedWait(mutex, 100);
+  return !error;
+}
+
+void cRecordingWriter::Action(void)
+{
+  cUnbufferedFile *File = fileName->Open();
+  for (;;) {
+      mutex.Lock();
+      cRecordingWriterBlock *Block = blocks.First();
+      if (!Block && current && lastActivity.Elapsed() > WRITERMAXDELAY) {
+         // The data stream has stalled, so let's not keep the partially filled block any longer:
+         Queue();
+         Block = blocks.First();
+         }
+      if (!Block) {
+         if (!Running()) {
+            mutex.Unlock();
+            break;
+            }
+         blockReady.TimedWait(mutex, 100);
+         mutex.Unlock();
+         continue;
+         }
+      blocks.Del(Block, false);
+      mutex.Unlock();
+      if (!error) {
+         if (Block->nextFile) {
+            File = fileName->NextFile();
+            if (!File)
+               error = true;
+            }
+         if (File && Block->length && File->Write(Block->data, Block->length) < 0) {
+            LOG_ERROR_STR(fileName->Name());
+            error = true;
+            }
+         if (!error && index) {
+            for (int i = 0; i < Block->marks.Size(); i++)
+                index->Write(Block->marks[i] & 1, fileName->Number(), Block->marks[i] >> 1);
+            }
+         }
+      mutex.Lock();
+      if (freeBlocks.Count() < WRITERFREEBLOCKS)
+         freeBlocks.Add(Block);
+      else
+         delete Block;
+      pending--;
+      blockDone.Broadcast();
+      mutex.Unlock();
+      }
+}
+
 // --- Index stuff -----------------------------------------------------------
 
 cString IndexToHMSF(int Index, bool WithFrame, double FramesPerSecond)
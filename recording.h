@@ -38,6 +38,7 @@ enum eRecordingUsage {
   ruDst      = 0x0040, // the recording is the destination of a cut, move or copy process
   //
   ruPending  = 0x0080, // the recording is pending a cut, move or copy process
+  ruIndex    = 0x0100, // the recording's index file is being regenerated
   };
 
 void RemoveDeletedRecordings(void);
@@ -97,6 +98,8 @@ public:
 
 class cRecording : public cListObject {
   friend class cRecordings;
+  friend class cRecordingsCatalog;
+  friend class cRecordingsScanner;
 private:
   mutable int resume;
   mutable char *titleBuffer;
@@ -117,6 +120,8 @@ private:
   static char *StripEpisodeName(char *s, bool Strip);
   char *SortName(void) const;
   void ClearSortName(void);
+  void Construct(const char *FileName, const char *InfoData);
+  cRecording(const char *FileName, const char *InfoData);
   time_t start;
   int priority;
   int lifetime;
@@ -216,16 +221,23 @@ public:
        ///< as in time-shift).
   };
 
+class cRecordingsCatalog;
+class cRecordingsWatcher;
+
 class cRecordings : public cList<cRecording>, public cThread {
+  friend class cRecordingsWatcher;
+  friend class cRecordingsScanner;
 private:
   static char *updateFileName;
   bool deleted;
   bool initial;
   time_t lastUpdate;
   int state;
+  cRecordingsCatalog *catalog;
+  cRecordingsWatcher *watcher;
   const char *UpdateFileName(void);
   void Refresh(bool Foreground = false);
-  bool ScanVideoDir(const char *DirName, bool Foreground = false, int LinkLevel = 0, int DirLevel = 0);
+  bool ScanVideoDir(const char *DirName, bool Foreground = false);
 protected:
   void Action(void);
 public:
@@ -235,6 +247,11 @@ public:
        ///< Loads the current list of recordings and returns true if there
        ///< is anything in it (for compatibility with older plugins - use
        ///< Update(true) instead).
+  void SetCatalogFileName(const char *FileName);
+       ///< Sets the name of the file that holds the recordings catalog. The catalog
+       ///< keeps the data of all recordings, so that the next time VDR starts only
+       ///< those directories need to be scanned that have changed in the meantime.
+       ///< Must be called before the first call to Update().
   bool Update(bool Wait = false);
        ///< Triggers an update of the list of recordings, which will run
        ///< as a separate thread if Wait is false. If Wait is true, the
@@ -246,13 +263,18 @@ public:
        ///< instances of VDR that access the same video directory can be triggered
        ///< to update their recordings list.
   bool NeedsUpdate(void);
+       ///< Returns true if the list of recordings needs to be updated. As long as the
+       ///< video directory is watched for changes (using inotify), local changes are
+       ///< applied to the list right away, and a full update is only necessary if any
+       ///< of them have been lost. Changes made by other hosts (which are not reported
+       ///< by inotify on network file systems) are detected through the '.update' file.
   void ChangeState(void) { state++; }
   bool StateChanged(int &State);
   void ResetResume(const char *ResumeFileName = NULL);
   void ClearSortNames(void);
   cRecording *GetByName(const char *FileName);
   void AddByName(const char *FileName, bool TriggerUpdate = true);
-  void DelByName(const char *FileName);
+  void DelByName(const char *FileName, bool TriggerUpdate = true);
   void UpdateByName(const char *FileName);
   int TotalFileSizeMB(void);
   double MBperMinute(void);
@@ -292,6 +314,7 @@ class cRecordingsHandler {
 private:
   cMutex mutex;
   cList<cRecordingsHandlerEntry> operations;
+  cStringList indexing;
   bool finished;
   bool error;
   cRecordingsHandlerEntry *Get(const char *FileName);
@@ -313,8 +336,15 @@ public:
        ///< that was given when the operation was added with Add().
   void DelAll(void);
        ///< Deletes/terminates all operations.
+  void SetIndexing(const char *FileName, bool On);
+       ///< Marks the given FileName as having its index file regenerated (On == true),
+       ///< or clears that mark (On == false).
   int GetUsage(const char *FileName);
        ///< Returns the usage type for the given FileName.
+  int GetProgress(const char *FileName);
+       ///< Returns the progress (in percent) of the move or copy operation
+       ///< for the given FileName, or -1 if no such operation is currently
+       ///< running.
   bool Active(void);
        ///< Checks whether there is currently any operation running and starts
        ///> the next one form the list if the previous one has finished.
@@ -428,13 +458,30 @@ private:
   cString fileName;
   int size, last;
   tIndexTs *index;
+  size_t mappedSize;
+  int mappedFile; // the mapped index file, if f has been closed
   bool isPesRecording;
   cResumeFile resumeFile;
   cIndexFileGenerator *indexFileGenerator;
   cMutex mutex;
+  cVector<int> iFrames;
+  int iFramesLast;
+  bool Map(int Size);
+       ///< Maps (or remaps) the index file into memory, with room for at least
+       ///< Size entries. Only used for TS recordings that are not being written
+       ///< to by this object, because their index needs no conversion.
+  void CheckMapping(void);
+       ///< Makes sure the mapped index file hasn't been truncated (accessing the
+       ///< mapping beyond the end of the file would cause a SIGBUS). If it has,
+       ///< the remaining entries are read into memory instead.
+       ///< The caller must hold the mutex.
   void ConvertFromPes(tIndexTs *IndexTs, int Count);
   void ConvertToPes(tIndexTs *IndexTs, int Count);
   bool CatchUp(int Index = -1);
+  void UpdateIFrames(void);
+       ///< Adds the I-frames between iFramesLast and last to iFrames.
+  int FindIFrame(int Index);
+       ///< Returns the position within iFrames of the first I-frame at or after Index.
 public:
   cIndexFile(const char *FileName, bool Record, bool IsPesRecording = false, bool PauseLive = false, bool Update = false);
   ~cIndexFile();
@@ -480,6 +527,60 @@ public:
   cUnbufferedFile *NextFile(void);
   };
 
+class cRecordingWriterBlock;
+
+class cRecordingWriter : public cThread {
+private:
+  cFileName *fileName;
+  cIndexFile *index;
+  cMutex mutex;
+  cCondVar blockReady;
+  cCondVar blockDone;
+  cList<cRecordingWriterBlock> blocks;
+  cList<cRecordingWriterBlock> freeBlocks;
+  cRecordingWriterBlock *current;
+  int pending;
+  cTimeMs currentAge;
+  cTimeMs lastActivity;
+  off_t fileSize;
+  bool error;
+  void Queue(void);
+  cRecordingWriterBlock *NewBlock(bool NextFile = false);
+protected:
+  virtual void Action(void);
+public:
+  cRecordingWriter(cFileName *FileName, cIndexFile *Index);
+       ///< Creates a writer that writes the TS data of a recording into the files
+       ///< given by FileName (which must already have been opened), and the
+       ///< index entries into Index (which may be NULL), in a separate thread.
+       ///< The data is collected in large blocks, so that the caller never has
+       ///< to wait for the actual disk I/O. Index entries are written only after
+       ///< the data they point to has been written. A partially filled block is
+       ///< written at the latest shortly after the data stream has stalled.
+  virtual ~cRecordingWriter();
+       ///< Writes all pending data before returning.
+  void Write(const uchar *Data, int Length);
+       ///< Appends Length bytes of Data to the current file.
+  void WriteIndex(bool Independent);
+       ///< Adds an index entry that points to the current position in the
+       ///< current file.
+  void NextFile(void);
+       ///< Continues with the next file. All further data will go into that file.
+  off_t FileSize(void) { return fileSize; }
+       ///< Returns the number of bytes written to the current file so far
+       ///< (including any data that is still pending).
+  bool WaitForSpace(int TimeoutMs);
+       ///< Waits at most TimeoutMs milliseconds until the number of blocks waiting
+       ///< to be written is below the limit, and returns true if this is the case.
+       ///< A caller that wants to avoid using an unlimited amount of memory should
+       ///< not call Write() unless this function returns true.
+  bool Flush(void);
+       ///< Waits until all pending data has been written.
+       ///< Returns false if an error has occurred.
+  bool Error(void) { return error; }
+       ///< Returns true if writing the data or opening the next file has failed.
+  };
+
 cString IndexToHMSF(int Index, bool WithFrame = false, double FramesPerSecond = DEFAULTFRAMESPERSECOND);
       // Converts the given index to a string, optionally containing the frame number.
 int HMSFToIndex(const char *HMSF, double FramesPerSecond = DEFAULTFRAMESPERSECOND);
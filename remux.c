@@ -318,6 +318,23 @@ void cTsPayload::SetByte(uchar Byte, int Index)
      data[Index] = Byte;
 }
 
+void cTsPayload::SkipToStartCode(uint32_t &Scanner)
+{
+  // A start code can only begin with a zero byte, so unless Scanner already holds
+  // the beginning of one, any non-zero bytes can be skipped at once. The last byte
+  // of the current TS packet is left to GetByte(), so that the caller still sees
+  // the TS packet boundary as if it had read each byte individually:
+  if ((Scanner & 0xFF) != 0x00 && (Scanner & 0xFFFFFF) != 0x000001 && !Eof() && index % TS_SIZE) {
+     int End = min(length, (index / TS_SIZE + 1) * TS_SIZE) - 1;
+     uchar *p = (uchar *)memchr(data + index, 0x00, End - index);
+     int Next = p ? p - data : End;
+     if (Next > index) {
+        index = Next;
+        Scanner = EMPTY_SCANNER;
+        }
+     }
+}
+
 bool cTsPayload::Find(uint32_t Code)
 {
   int OldIndex = index;
@@ -325,6 +342,8 @@ bool cTsPayload::Find(uint32_t Code)
   int OldNumPacketsOther = numPacketsOther;
   uint32_t Scanner = EMPTY_SCANNER;
   while (!Eof()) {
+        if ((Code & 0xFFFFFF00) == 0x00000100)
+           SkipToStartCode(Scanner);
         Scanner = (Scanner << 8) | GetByte();
         if (Scanner == Code)
            return true;
@@ -1150,6 +1169,7 @@ int cMpeg2Parser::Parse(const uchar *Data, int Length, int Pid)
      }
   uint32_t OldScanner = scanner; // need to remember it in case of multiple frames per payload
   for (;;) {
+      tsPayload.SkipToStartCode(scanner);
       if (!SeenPayloadStart && tsPayload.AtTsStart())
          OldScanner = scanner;
       scanner = (scanner << 8) | tsPayload.GetByte();
@@ -1316,6 +1336,7 @@ int cH264Parser::Parse(const uchar *Data, int Length, int Pid)
         }
      }
   for (;;) {
+      tsPayload.SkipToStartCode(scanner);
       scanner = (scanner << 8) | GetByte(true);
       if ((scanner & 0xFFFFFF00) == 0x00000100) { // NAL unit start
          uchar NalUnitType = scanner & 0x1F;
@@ -269,6 +269,10 @@ public:
        ///< Index should be one that has been retrieved by a previous call to GetIndex(),
        ///< otherwise the behaviour is undefined. The current read index will not be
        ///< altered by a call to this function.
+  void SkipToStartCode(uint32_t &Scanner);
+       ///< Skips all bytes in the rest of the current TS packet that can't be part of a
+       ///< start code (0x000001xx), given that Scanner holds the most recently read bytes.
+       ///< If any bytes are skipped, Scanner is reset accordingly.
   bool Find(uint32_t Code);
        ///< Searches for the four byte sequence given in Code and returns true if it
        ///< was found within the payload data. The next call to GetByte() will return the
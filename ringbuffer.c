@@ -12,6 +12,7 @@
 
 #include "ringbuffer.h"
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include "tools.h"
 
@@ -22,6 +23,11 @@
 #define PERCENTAGETHRESHOLD 70
 #define IOTHROTTLELOW       20
 #define IOTHROTTLEHIGH      50
+#define HUGEPAGESIZE        MEGABYTE(2)
+
+cMutex cRingBuffer::buffersMutex;
+cRingBuffer *cRingBuffer::buffers = NULL;
+bool cRingBuffer::useHugePages = false;
 
 cRingBuffer::cRingBuffer(int Size, bool Statistics)
 {
@@ -31,23 +37,97 @@ cRingBuffer::cRingBuffer(int Size, bool Statistics)
   maxFill = 0;
   lastPercent = 0;
   putTimeout = getTimeout = 0;
+  putWaiting = getWaiting = false;
   lastOverflowReport = 0;
   overflowCount = overflowBytes = 0;
+  totalOverflowBytes = 0;
+  lastFill = 0;
+  description = NULL;
+  mappedSize = 0;
   ioThrottle = NULL;
+  nextBuffer = NULL;
+  if (statistics) {
+     cMutexLock MutexLock(&buffersMutex);
+     nextBuffer = buffers;
+     buffers = this;
+     }
 }
 
 cRingBuffer::~cRingBuffer()
 {
+  if (statistics) {
+     cMutexLock MutexLock(&buffersMutex);
+     for (cRingBuffer **p = &buffers; *p; p = &(*p)->nextBuffer) {
+         if (*p == this) {
+            *p = nextBuffer;
+            break;
+            }
+         }
+     }
   delete ioThrottle;
   if (statistics)
-     dsyslog("buffer stats: %d (%d%%) used", maxFill, maxFill * 100 / (size - 1));
+     dsyslog("buffer stats: %d (%d%%) used", maxFill, int(maxFill * 100LL / (size - 1)));
+  free(description);
+}
+
+void cRingBuffer::SetDescription(const char *Description)
+{
+  cMutexLock MutexLock(&buffersMutex);
+  free(description);
+  description = Description ? strdup(Description) : NULL;
+}
+
+uchar *cRingBuffer::AllocBuffer(int Size)
+{
+  if (useHugePages) {
+     size_t Length = (Size + HUGEPAGESIZE - 1) / HUGEPAGESIZE * HUGEPAGESIZE;
+     void *p = mmap(NULL, Length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+     if (p == MAP_FAILED) {
+        // no reserved huge pages, so let's at least try transparent huge pages:
+        p = mmap(NULL, Length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED)
+           madvise(p, Length, MADV_HUGEPAGE);
+        }
+     if (p != MAP_FAILED) {
+        mappedSize = Length;
+        return (uchar *)p;
+        }
+     LOG_ERROR;
+     }
+  mappedSize = 0;
+  return MALLOC(uchar, Size);
+}
+
+void cRingBuffer::FreeBuffer(uchar *Buffer)
+{
+  if (mappedSize) {
+     if (Buffer)
+        munmap(Buffer, mappedSize);
+     mappedSize = 0;
+     }
+  else
+     free(Buffer);
+}
+
+void cRingBuffer::GetStatistics(cStringList &Statistics)
+{
+  cMutexLock MutexLock(&buffersMutex);
+  for (cRingBuffer *b = buffers; b; b = b->nextBuffer) {
+      int Size = max(b->size - 1, 1);
+      Statistics.Append(strdup(cString::sprintf("%s: size %d, used %d (%d%%), max %d (%d%%), overflows %d bytes",
+                               b->description ? b->description : "?", b->size,
+                               b->lastFill, int(b->lastFill * 100LL / Size),
+                               b->maxFill, int(b->maxFill * 100LL / Size),
+                               b->totalOverflowBytes)));
+      }
 }
 
 void cRingBuffer::UpdatePercentage(int Fill)
 {
+  lastFill = Fill;
   if (Fill > maxFill)
      maxFill = Fill;
-  int percent = Fill * 100 / (Size() - 1) / PERCENTAGEDELTA * PERCENTAGEDELTA; // clamp down to nearest quantum
+  int percent = Fill * 100LL / (Size() - 1) / PERCENTAGEDELTA * PERCENTAGEDELTA; // clamp down to nearest quantum
   if (percent != lastPercent) {
      if (percent >= PERCENTAGETHRESHOLD && percent > lastPercent || percent < PERCENTAGETHRESHOLD && lastPercent >= PERCENTAGETHRESHOLD) {
         dsyslog("buffer usage: %d%% (tid=%d)", percent, getThreadTid);
@@ -62,28 +142,49 @@ void cRingBuffer::UpdatePercentage(int Fill)
      }
 }
 
+// The producer and the consumer only go through the (comparatively expensive)
+// cCondWait if the other side has announced that it is actually waiting. The
+// full memory barriers make sure that either the waiting side sees the new
+// fill level, or the signaling side sees the announcement, so no wakeup is lost.
+
 void cRingBuffer::WaitForPut(void)
 {
-  if (putTimeout)
-     readyForPut.Wait(putTimeout);
+  if (putTimeout) {
+     __atomic_store_n(&putWaiting, true, __ATOMIC_RELAXED);
+     __atomic_thread_fence(__ATOMIC_SEQ_CST);
+     if (Free() <= Size() / 10)
+        readyForPut.Wait(putTimeout);
+     __atomic_store_n(&putWaiting, false, __ATOMIC_RELAXED);
+     }
 }
 
 void cRingBuffer::WaitForGet(void)
 {
-  if (getTimeout)
-     readyForGet.Wait(getTimeout);
+  if (getTimeout) {
+     __atomic_store_n(&getWaiting, true, __ATOMIC_RELAXED);
+     __atomic_thread_fence(__ATOMIC_SEQ_CST);
+     if (Available() <= Size() / 10)
+        readyForGet.Wait(getTimeout);
+     __atomic_store_n(&getWaiting, false, __ATOMIC_RELAXED);
+     }
 }
 
 void cRingBuffer::EnablePut(void)
 {
-  if (putTimeout && Free() > Size() / 10)
-     readyForPut.Signal();
+  if (putTimeout) {
+     __atomic_thread_fence(__ATOMIC_SEQ_CST);
+     if (__atomic_load_n(&putWaiting, __ATOMIC_RELAXED) && Free() > Size() / 10)
+        readyForPut.Signal();
+     }
 }
 
 void cRingBuffer::EnableGet(void)
 {
-  if (getTimeout && Available() > Size() / 10)
-     readyForGet.Signal();
+  if (getTimeout) {
+     __atomic_thread_fence(__ATOMIC_SEQ_CST);
+     if (__atomic_load_n(&getWaiting, __ATOMIC_RELAXED) && Available() > Size() / 10)
+        readyForGet.Signal();
+     }
 }
 
 void cRingBuffer::SetTimeouts(int PutTimeout, int GetTimeout)
@@ -102,6 +203,7 @@ void cRingBuffer::ReportOverflow(int Bytes)
 {
   overflowCount++;
   overflowBytes += Bytes;
+  totalOverflowBytes += Bytes;
   if (time(NULL) - lastOverflowReport > OVERFLOWREPORTDELTA) {
      esyslog("ERROR: %d ring buffer overflow%s (%d bytes dropped)", overflowCount, overflowCount > 1 ? "s" : "", overflowBytes);
      overflowCount = overflowBytes = 0;
@@ -111,6 +213,11 @@ void cRingBuffer::ReportOverflow(int Bytes)
 
 // --- cRingBufferLinear -----------------------------------------------------
 
+// 'head' is only written by the producer and 'tail' only by the consumer, so
+// these two are accessed with acquire/release semantics instead of locking:
+#define LOAD(Var)         __atomic_load_n(&(Var), __ATOMIC_ACQUIRE)
+#define STORE(Var, Value) __atomic_store_n(&(Var), (Value), __ATOMIC_RELEASE)
+
 #ifdef DEBUGRINGBUFFERS
 #define MAXRBLS 30
 #define DEBUGRBLWIDTH 45
@@ -159,7 +266,7 @@ void cRingBufferLinear::PrintDebugRBL(void)
          buf[t] = '<';
          buf[h] = '>';
          buf[DEBUGRBLWIDTH] = 0;
-         printf("%2d %s %8d %8d %s\n", i, buf, p->lastPut, p->lastGet, p->description);
+         printf("%2d %s %8d %8d %s\n", i, buf, p->lastPut, p->lastGet, p->Description());
          }
       }
   if (printed)
@@ -170,13 +277,13 @@ void cRingBufferLinear::PrintDebugRBL(void)
 cRingBufferLinear::cRingBufferLinear(int Size, int Margin, bool Statistics, const char *Description)
 :cRingBuffer(Size, Statistics)
 {
-  description = Description ? strdup(Description) : NULL;
+  SetDescription(Description);
   tail = head = margin = Margin;
   gotten = 0;
   buffer = NULL;
   if (Size > 1) { // 'Size - 1' must not be 0!
      if (Margin <= Size / 2) {
-        buffer = MALLOC(uchar, Size);
+        buffer = AllocBuffer(Size);
         if (!buffer)
            esyslog("ERROR: can't allocate ring buffer (size=%d)", Size);
         Clear();
@@ -199,8 +306,7 @@ cRingBufferLinear::~cRingBufferLinear()
 #ifdef DEBUGRINGBUFFERS
   DelDebugRBL(this);
 #endif
-  free(buffer);
-  free(description);
+  FreeBuffer(buffer);
 }
 
 int cRingBufferLinear::DataReady(const uchar *Data, int Count)
@@ -210,13 +316,14 @@ int cRingBufferLinear::DataReady(const uchar *Data, int Count)
 
 int cRingBufferLinear::Available(void)
 {
-  int diff = head - tail;
+  int diff = LOAD(head) - LOAD(tail);
   return (diff >= 0) ? diff : Size() + diff - margin;
 }
 
 void cRingBufferLinear::Clear(void)
 {
-  tail = head = margin;
+  STORE(tail, margin);
+  STORE(head, margin);
 #ifdef DEBUGRINGBUFFERS
   lastHead = head;
   lastTail = tail;
@@ -228,7 +335,7 @@ void cRingBufferLinear::Clear(void)
 
 int cRingBufferLinear::Read(int FileHandle, int Max)
 {
-  int Tail = tail;
+  int Tail = LOAD(tail);
   int diff = Tail - head;
   int free = (diff > 0) ? diff - 1 : Size() - head;
   if (Tail <= margin)
@@ -243,7 +350,7 @@ int cRingBufferLinear::Read(int FileHandle, int Max)
         int Head = head + Count;
         if (Head >= Size())
            Head = margin;
-        head = Head;
+        STORE(head, Head);
         if (statistics) {
            int fill = head - Tail;
            if (fill < 0)
@@ -266,7 +373,7 @@ int cRingBufferLinear::Read(int FileHandle, int Max)
 
 int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
 {
-  int Tail = tail;
+  int Tail = LOAD(tail);
   int diff = Tail - head;
   int free = (diff > 0) ? diff - 1 : Size() - head;
   if (Tail <= margin)
@@ -281,7 +388,7 @@ int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
         int Head = head + Count;
         if (Head >= Size())
            Head = margin;
-        head = Head;
+        STORE(head, Head);
         if (statistics) {
            int fill = head - Tail;
            if (fill < 0)
@@ -305,7 +412,7 @@ int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
 int cRingBufferLinear::Put(const uchar *Data, int Count)
 {
   if (Count > 0) {
-     int Tail = tail;
+     int Tail = LOAD(tail);
      int rest = Size() - head;
      int diff = Tail - head;
      int free = ((Tail < margin) ? rest : (diff > 0) ? diff : Size() + diff - margin) - 1;
@@ -322,11 +429,11 @@ int cRingBufferLinear::Put(const uchar *Data, int Count)
            memcpy(buffer + head, Data, rest);
            if (Count - rest)
               memcpy(buffer + margin, Data + rest, Count - rest);
-           head = margin + Count - rest;
+           STORE(head, margin + Count - rest);
            }
         else {
            memcpy(buffer + head, Data, Count);
-           head += Count;
+           STORE(head, head + Count);
            }
         }
      else
@@ -344,14 +451,14 @@ int cRingBufferLinear::Put(const uchar *Data, int Count)
 
 uchar *cRingBufferLinear::Get(int &Count)
 {
-  int Head = head;
+  int Head = LOAD(head);
   if (getThreadTid <= 0)
      getThreadTid = cThread::ThreadId();
   int rest = Size() - tail;
   if (rest < margin && Head < tail) {
      int t = margin - rest;
      memcpy(buffer + t, buffer + tail, rest);
-     tail = t;
+     STORE(tail, t);
      rest = Head - tail;
      }
   int diff = Head - tail;
@@ -379,7 +486,7 @@ void cRingBufferLinear::Del(int Count)
      gotten -= Count;
      if (Tail >= Size())
         Tail = margin;
-     tail = Tail;
+     STORE(tail, Tail);
      EnablePut();
      }
 #ifdef DEBUGRINGBUFFERS
@@ -388,6 +495,254 @@ void cRingBufferLinear::Del(int Count)
 #endif
 }
 
+// --- cRingBufferShared -----------------------------------------------------
+
+cRingBufferShared::cRingBufferShared(int Size, int Margin, bool Statistics, const char *Description)
+:cRingBuffer(Size, Statistics)
+{
+  SetDescription(Description);
+  head = margin = Margin;
+  for (int i = 0; i < MAXRINGBUFFERREADERS; i++) {
+      readers[i].used = false;
+      readers[i].tail = head;
+      readers[i].gotten = 0;
+      readers[i].busy = false;
+      readers[i].lagging = false;
+      readers[i].stopped = false;
+      }
+  numReaders = 0;
+  buffer = NULL;
+  if (Size > 1) { // 'Size - 1' must not be 0!
+     if (Margin <= Size / 2) {
+        buffer = AllocBuffer(Size);
+        if (!buffer)
+           esyslog("ERROR: can't allocate ring buffer (size=%d)", Size);
+        }
+     else
+        esyslog("ERROR: invalid margin for ring buffer (%d > %d)", Margin, Size / 2);
+     }
+  else
+     esyslog("ERROR: invalid size for ring buffer (%d)", Size);
+}
+
+cRingBufferShared::~cRingBufferShared()
+{
+  FreeBuffer(buffer);
+}
+
+int cRingBufferShared::AddReader(void)
+{
+  cMutexLock MutexLock(&mutex);
+  for (int i = 0; i < MAXRINGBUFFERREADERS; i++) {
+      if (!readers[i].used) {
+         readers[i].used = true;
+         readers[i].tail = head;
+         readers[i].gotten = 0;
+         readers[i].busy = false;
+         readers[i].lagging = false;
+         readers[i].stopped = false;
+         numReaders++;
+         return i;
+         }
+      }
+  esyslog("ERROR: too many readers for ring buffer %s", Description() ? Description() : "");
+  return -1;
+}
+
+int cRingBufferShared::DelReader(int Reader)
+{
+  cMutexLock MutexLock(&mutex);
+  if (Reader >= 0 && Reader < MAXRINGBUFFERREADERS && readers[Reader].used) {
+     readers[Reader].used = false;
+     numReaders--;
+     EnablePut();
+     }
+  return numReaders;
+}
+
+void cRingBufferShared::StopReader(int Reader)
+{
+  cMutexLock MutexLock(&mutex);
+  if (Reader >= 0 && Reader < MAXRINGBUFFERREADERS && readers[Reader].used) {
+     // A stopped reader is treated like a lagging one that never catches up:
+     readers[Reader].lagging = true;
+     readers[Reader].stopped = true;
+     EnablePut();
+     }
+}
+
+int cRingBufferShared::FreeFor(int Tail)
+{
+  int rest = Size() - head;
+  int diff = Tail - head;
+  return ((Tail < margin) ? rest : (diff > 0) ? diff : Size() + diff - margin) - 1;
+}
+
+int cRingBufferShared::AvailableFor(int Tail)
+{
+  int diff = head - Tail;
+  return (diff >= 0) ? diff : Size() + diff - margin;
+}
+
+int cRingBufferShared::Available(void)
+{
+  cMutexLock MutexLock(&mutex);
+  int Available = 0;
+  for (int i = 0; i < MAXRINGBUFFERREADERS; i++) {
+      if (readers[i].used && !readers[i].lagging)
+         Available = max(Available, AvailableFor(readers[i].tail));
+      }
+  return Available;
+}
+
+int cRingBufferShared::Free(void)
+{
+  return Size() - Available() - 1 - margin;
+}
+
+void cRingBufferShared::Clear(void)
+{
+  cMutexLock MutexLock(&mutex);
+  head = margin;
+  for (int i = 0; i < MAXRINGBUFFERREADERS; i++) {
+      readers[i].tail = head;
+      readers[i].lagging = readers[i].stopped;
+      }
+  maxFill = 0;
+  EnablePut();
+}
+
+int cRingBufferShared::Put(const uchar *Data, int Count)
+{
+  if (Count > 0) {
+     int free = Size();
+     mutex.Lock();
+     for (int i = 0; i < MAXRINGBUFFERREADERS; i++) {
+         if (readers[i].used && !readers[i].lagging)
+            free = min(free, FreeFor(readers[i].tail));
+         }
+     if (free < Count && numReaders > 1) {
+        // Drop the data of any reader that has fallen behind the others, rather
+        // than making all of them lose the new data:
+        int FreeOthers = Size();
+        for (int i = 0; i < MAXRINGBUFFERREADERS; i++) {
+            tReader &r = readers[i];
+            if (r.used && !r.lagging && (FreeFor(r.tail) >= Count || r.busy))
+               FreeOthers = min(FreeOthers, FreeFor(r.tail));
+            }
+        if (FreeOthers >= Count && FreeOthers < Size()) { // at least one reader keeps up
+           for (int i = 0; i < MAXRINGBUFFERREADERS; i++) {
+               tReader &r = readers[i];
+               if (r.used && !r.lagging && FreeFor(r.tail) < Count && !r.busy) {
+                  esyslog("ERROR: reader %d of ring buffer %s has fallen behind", i, Description() ? Description() : "");
+                  ReportOverflow(AvailableFor(r.tail));
+                  r.lagging = true;
+                  }
+               }
+           free = FreeOthers;
+           }
+        }
+     mutex.Unlock();
+     if (free == Size()) // there are no readers
+        return Count;
+     if (statistics) {
+        int fill = Size() - free - 1 + Count;
+        if (fill >= Size())
+           fill = Size() - 1;
+        UpdatePercentage(fill);
+        }
+     if (free > 0) {
+        int rest = Size() - head;
+        if (free < Count)
+           Count = free;
+        if (Count >= rest) {
+           memcpy(buffer + head, Data, rest);
+           if (Count - rest)
+              memcpy(buffer + margin, Data + rest, Count - rest);
+           STORE(head, margin + Count - rest);
+           }
+        else {
+           memcpy(buffer + head, Data, Count);
+           STORE(head, head + Count);
+           }
+        }
+     else
+        Count = 0;
+     for (int i = 0; i < MAXRINGBUFFERREADERS; i++) {
+         if (readers[i].used && readers[i].lagging && !readers[i].stopped)
+            ReportOverflow(Count); // this data is lost for the lagging reader
+         if (getTimeout && readers[i].used) {
+            if (readers[i].lagging || AvailableFor(LOAD(readers[i].tail)) > Size() / 10)
+               readers[i].readyForGet.Signal();
+            }
+         }
+     if (Count == 0)
+        WaitForPut();
+     }
+  return Count;
+}
+
+uchar *cRingBufferShared::Get(int Reader, int &Count)
+{
+  tReader &r = readers[Reader];
+  if (getThreadTid <= 0)
+     getThreadTid = cThread::ThreadId();
+  mutex.Lock();
+  if (r.lagging) {
+     // The data of this reader has been dropped, so it continues with the newest data:
+     dsyslog("reader %d of ring buffer %s continues after falling behind", Reader, Description() ? Description() : "");
+     r.tail = head;
+     r.gotten = 0;
+     r.lagging = false;
+     }
+  int Head = head;
+  int rest = Size() - r.tail;
+  if (rest < margin && Head < r.tail) {
+     // All readers copy the same bytes to the same place here, so this
+     // doesn't interfere with any other reader:
+     int t = margin - rest;
+     memcpy(buffer + t, buffer + r.tail, rest);
+     r.tail = t;
+     rest = Head - r.tail;
+     }
+  int diff = Head - r.tail;
+  int cont = (diff >= 0) ? diff : Size() + diff - margin;
+  if (cont > rest)
+     cont = rest;
+  if (cont >= margin) {
+     Count = r.gotten = cont;
+     r.busy = true;
+     mutex.Unlock();
+     return buffer + r.tail;
+     }
+  mutex.Unlock();
+  if (getTimeout)
+     r.readyForGet.Wait(getTimeout);
+  return NULL;
+}
+
+void cRingBufferShared::Del(int Reader, int Count)
+{
+  tReader &r = readers[Reader];
+  cMutexLock MutexLock(&mutex);
+  r.busy = false;
+  if (r.lagging)
+     return; // the data has already been dropped
+  if (Count > r.gotten) {
+     esyslog("ERROR: invalid Count in cRingBufferShared::Del: %d (limited to %d)", Count, r.gotten);
+     Count = r.gotten;
+     }
+  if (Count > 0) {
+     int Tail = r.tail;
+     Tail += Count;
+     r.gotten -= Count;
+     if (Tail >= Size())
+        Tail = margin;
+     STORE(r.tail, Tail);
+     EnablePut();
+     }
+}
+
 // --- cFrame ----------------------------------------------------------------
 
 cFrame::cFrame(const uchar *Data, int Count, eFrameType Type, int Index, uint32_t Pts)
@@ -15,15 +15,24 @@
 
 class cRingBuffer {
 private:
+  static cMutex buffersMutex;
+  static cRingBuffer *buffers;
+  static bool useHugePages;
+  cRingBuffer *nextBuffer;
   cCondWait readyForPut, readyForGet;
-  int putTimeout;
-  int getTimeout;
+  bool putWaiting, getWaiting;
   int size;
   time_t lastOverflowReport;
   int overflowCount;
   int overflowBytes;
+  int totalOverflowBytes;
+  int lastFill;
+  char *description;
+  size_t mappedSize;
   cIoThrottle *ioThrottle;
 protected:
+  int putTimeout;
+  int getTimeout;
   tThreadId getThreadTid;
   int maxFill;//XXX
   int lastPercent;
@@ -37,14 +46,33 @@ protected:
   virtual int Available(void) = 0;
   virtual int Free(void) { return Size() - Available() - 1; }
   int Size(void) { return size; }
+  uchar *AllocBuffer(int Size);
+       ///< Allocates the memory for a ring buffer of the given Size, either from
+       ///< the heap or, if SetHugePages() has been called, as an anonymous memory
+       ///< mapping that is backed by huge pages (if possible).
+  void FreeBuffer(uchar *Buffer);
+       ///< Frees a Buffer that has been allocated by AllocBuffer().
+  void SetDescription(const char *Description);
+  const char *Description(void) { return description; }
 public:
   cRingBuffer(int Size, bool Statistics = false);
   virtual ~cRingBuffer();
   void SetTimeouts(int PutTimeout, int GetTimeout);
   void SetIoThrottle(void);
   void ReportOverflow(int Bytes);
+  static void SetHugePages(bool On) { useHugePages = On; }
+       ///< If On is true, the memory of ring buffers created from now on will
+       ///< be taken from huge pages, which reduces TLB misses with large buffers.
+  static void GetStatistics(cStringList &Statistics);
+       ///< Adds a line with the current fill level, the maximum fill level and
+       ///< the number of bytes lost due to overflows to Statistics, for each ring
+       ///< buffer that keeps statistics.
   };
 
+/// A cRingBufferLinear can be used by exactly one producer thread (calling Read()
+/// or Put()) and one consumer thread (calling Get() and Del()) at the same time,
+/// without any additional locking.
+
 class cRingBufferLinear : public cRingBuffer {
 //#define DEBUGRINGBUFFERS
 #ifdef DEBUGRINGBUFFERS
@@ -61,7 +89,6 @@ private:
   int margin, head, tail;
   int gotten;
   uchar *buffer;
-  char *description;
 protected:
   virtual int DataReady(const uchar *Data, int Count);
     ///< By default a ring buffer has data ready as soon as there are at least
@@ -102,6 +129,72 @@ public:
     ///< call to Get().
   };
 
+#define MAXRINGBUFFERREADERS 16
+
+class cRingBufferShared : public cRingBuffer {
+private:
+  cMutex mutex;
+  int margin, head;
+  struct tReader {
+    bool used;
+    int tail;
+    int gotten;
+    bool busy;    // the reader is accessing the data it got with Get()
+    bool lagging; // the reader has fallen behind and its data is no longer kept
+    bool stopped; // the reader no longer reads any data
+    cCondWait readyForGet;
+    } readers[MAXRINGBUFFERREADERS];
+  int numReaders;
+  uchar *buffer;
+  int FreeFor(int Tail);
+  int AvailableFor(int Tail);
+public:
+  cRingBufferShared(int Size, int Margin = 0, bool Statistics = false, const char *Description = NULL);
+    ///< Creates a linear ring buffer with one producer and any number of consumers
+    ///< ("readers"), each of which reads the same data at its own pace. The data is
+    ///< stored only once and remains in the buffer until all readers have deleted it.
+    ///< Size and Margin have the same meaning as in cRingBufferLinear.
+    ///< A newly created buffer has no readers, so AddReader() needs to be called at
+    ///< least once.
+    ///< If one reader falls so far behind that new data would no longer fit into
+    ///< the buffer for it, while it would still fit for the others, the data of
+    ///< that reader is dropped, so that the other readers don't lose any data.
+    ///< The overflow is reported, and the lagging reader continues with the
+    ///< newest data on its next call to Get().
+  virtual ~cRingBufferShared();
+  int AddReader(void);
+    ///< Adds a new reader to this ring buffer, which will see all data that is
+    ///< put into the buffer from now on.
+    ///< Returns the reader's index, which has to be given to Get() and Del(), or
+    ///< -1 if no more readers can be added.
+  int DelReader(int Reader);
+    ///< Deletes the given Reader from this ring buffer.
+    ///< Returns the number of remaining readers. If this is 0, the caller is
+    ///< responsible for deleting the ring buffer.
+  void StopReader(int Reader);
+    ///< Tells the ring buffer that the given Reader won't call Get() any more
+    ///< (for instance because it has run into an error), so that no data is
+    ///< kept for it from now on. The Reader still counts as a reader of this
+    ///< ring buffer until it is deleted with DelReader().
+  virtual int Available(void);
+    ///< Returns the number of bytes available to the slowest reader.
+  virtual int Free(void);
+  virtual void Clear(void);
+    ///< Immediately clears the ring buffer for all readers.
+  int Put(const uchar *Data, int Count);
+    ///< Puts at most Count bytes of Data into the ring buffer.
+    ///< Returns the number of bytes actually stored.
+  uchar *Get(int Reader, int &Count);
+    ///< Gets data from the ring buffer for the given Reader.
+    ///< See cRingBufferLinear::Get() for details.
+    ///< Every call that returns data must be followed by a call to Del() (even
+    ///< if Count is 0 there) once the Reader no longer accesses that data.
+  void Del(int Reader, int Count);
+    ///< Deletes at most Count bytes from the ring buffer for the given Reader.
+    ///< Count must be less or equal to the number that was returned by a previous
+    ///< call to Get() for this Reader.
+  };
+
 enum eFrameType { ftUnknown, ftVideo, ftAudio, ftDolby };
 
 class cFrame {
@@ -59,7 +59,8 @@ void cSdtFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
 
       cLinkChannels *LinkChannels = NULL;
       SI::Descriptor *d;
-      for (SI::Loop::Iterator it2; (d = SiSdtService.serviceDescriptors.getNext(it2)); ) {
+      SI::DescriptorBuffer DescriptorBuffer;
+      for (SI::Loop::Iterator it2; (d = SiSdtService.serviceDescriptors.getNext(it2, DescriptorBuffer)); ) {
           switch (d->getDescriptorTag()) {
             case SI::ServiceDescriptorTag: {
                  SI::ServiceDescriptor *sd = (SI::ServiceDescriptor *)d;
@@ -143,7 +144,6 @@ void cSdtFilter::Process(u_short Pid, u_char Tid, const u_char *Data, int Length
                  break;
             default: ;
             }
-          delete d;
           }
       if (LinkChannels) {
          if (channel)
@@ -158,8 +158,11 @@ bool cPUTEhandler::Process(const char *s)
         return true;
         }
      else {
+        // The data is parsed without locking the schedules, which are then
+        // only locked for actually storing the events:
         rewind(f);
-        if (cSchedules::Read(f)) {
+        cEpgBatch EpgBatch;
+        if (EpgBatch.Read(f) && EpgBatch.Import()) {
            cSchedules::Cleanup(true);
            status = 250;
            message = "EPG data processed";
@@ -312,8 +315,21 @@ const char *HelpPages[] = {
   "SCAN\n"
   "    Forces an EPG scan. If this is a single DVB device system, the scan\n"
   "    will be done on the primary device unless it is currently recording.",
-  "STAT disk\n"
-  "    Return information about disk usage (total, free, percent).",
+  "SRCH [ channel <channels> ] [ from <time> ] [ to <time> ] [ max <number> ] <words>\n"
+  "    Search EPG data. Lists all events that contain the given words in their\n"
+  "    title, short text or description, in the same format as LSTE. Words\n"
+  "    are compared case insensitively, and words in double quotes must\n"
+  "    appear as a phrase. The search can be restricted to a comma separated\n"
+  "    list of channels (either by number or by channel ID), to events that\n"
+  "    are running at or after 'from', or start before 'to' (both in time_t\n"
+  "    form). 'max' limits the number of events listed, taking the ones that\n"
+  "    start first.",
+  "STAT disk | buffers | eit\n"
+  "    Return information about disk usage (total, free, percent), the\n"
+  "    current and maximum fill levels and the overflows of all ring buffers,\n"
+  "    or the number of EIT schedule sections that have been processed,\n"
+  "    skipped because they were unchanged, and dropped because they could\n"
+  "    not be processed fast enough.",
   "UPDT <settings>\n"
   "    Updates a timer. Settings must be in the same format as returned\n"
   "    by the LSTT command. If a timer with the same channel, day, start\n"
@@ -674,6 +690,8 @@ static cString RecordingInUseMessage(int Reason, const char *RecordingId, cRecor
      return cString::sprintf("Recording \"%s\" is being edited", RecordingId);
   else if ((Reason & (ruMove | ruCopy)) != 0)
      return cString::sprintf("Recording \"%s\" is being copied/moved", RecordingId);
+  else if ((Reason & ruIndex) != 0)
+     return cString::sprintf("Recording \"%s\" is being indexed", RecordingId);
   else if (Reason)
      return cString::sprintf("Recording \"%s\" is in use", RecordingId);
   return NULL;
@@ -1009,85 +1027,87 @@ void cSVDRP::CmdLSTC(const char *Option)
 
 void cSVDRP::CmdLSTE(const char *Option)
 {
-  cSchedulesLock SchedulesLock;
-  const cSchedules *Schedules = cSchedules::Schedules(SchedulesLock);
-  if (Schedules) {
-     const cSchedule* Schedule = NULL;
-     eDumpMode DumpMode = dmAll;
-     time_t AtTime = 0;
-     if (*Option) {
-        char buf[strlen(Option) + 1];
-        strcpy(buf, Option);
-        const char *delim = " \t";
-        char *strtok_next;
-        char *p = strtok_r(buf, delim, &strtok_next);
-        while (p && DumpMode == dmAll) {
-              if (strcasecmp(p, "NOW") == 0)
-                 DumpMode = dmPresent;
-              else if (strcasecmp(p, "NEXT") == 0)
-                 DumpMode = dmFollowing;
-              else if (strcasecmp(p, "AT") == 0) {
-                 DumpMode = dmAtTime;
-                 if ((p = strtok_r(NULL, delim, &strtok_next)) != NULL) {
-                    if (isnumber(p))
-                       AtTime = strtol(p, NULL, 10);
-                    else {
-                       Reply(501, "Invalid time");
-                       return;
-                       }
-                    }
-                 else {
-                    Reply(501, "Missing time");
-                    return;
-                    }
-                 }
-              else if (!Schedule) {
-                 cChannel* Channel = NULL;
+  cChannel *Channel = NULL;
+  eDumpMode DumpMode = dmAll;
+  time_t AtTime = 0;
+  if (*Option) {
+     char buf[strlen(Option) + 1];
+     strcpy(buf, Option);
+     const char *delim = " \t";
+     char *strtok_next;
+     char *p = strtok_r(buf, delim, &strtok_next);
+     while (p && DumpMode == dmAll) {
+           if (strcasecmp(p, "NOW") == 0)
+              DumpMode = dmPresent;
+           else if (strcasecmp(p, "NEXT") == 0)
+              DumpMode = dmFollowing;
+           else if (strcasecmp(p, "AT") == 0) {
+              DumpMode = dmAtTime;
+              if ((p = strtok_r(NULL, delim, &strtok_next)) != NULL) {
                  if (isnumber(p))
-                    Channel = Channels.GetByNumber(strtol(Option, NULL, 10));
-                 else
-                    Channel = Channels.GetByChannelID(tChannelID::FromString(Option));
-                 if (Channel) {
-                    Schedule = Schedules->GetSchedule(Channel);
-                    if (!Schedule) {
-                       Reply(550, "No schedule found");
-                       return;
-                       }
-                    }
+                    AtTime = strtol(p, NULL, 10);
                  else {
-                    Reply(550, "Channel \"%s\" not defined", p);
+                    Reply(501, "Invalid time");
                     return;
                     }
                  }
               else {
-                 Reply(501, "Unknown option: \"%s\"", p);
+                 Reply(501, "Missing time");
                  return;
                  }
-              p = strtok_r(NULL, delim, &strtok_next);
               }
-        }
-     int fd = dup(file);
-     if (fd) {
-        FILE *f = fdopen(fd, "w");
-        if (f) {
-           if (Schedule)
-              Schedule->Dump(f, "215-", DumpMode, AtTime);
+           else if (!Channel) {
+              if (isnumber(p))
+                 Channel = Channels.GetByNumber(strtol(Option, NULL, 10));
+              else
+                 Channel = Channels.GetByChannelID(tChannelID::FromString(Option));
+              if (!Channel) {
+                 Reply(550, "Channel \"%s\" not defined", p);
+                 return;
+                 }
+              }
+           else {
+              Reply(501, "Unknown option: \"%s\"", p);
+              return;
+              }
+           p = strtok_r(NULL, delim, &strtok_next);
+           }
+     }
+  int fd = dup(file);
+  if (fd) {
+     FILE *f = fdopen(fd, "w");
+     if (f) {
+        bool Ok = false;
+        if (Channel) {
+           cSchedulesLock SchedulesLock;
+           if (const cSchedules *Schedules = cSchedules::Schedules(SchedulesLock)) {
+              if (const cSchedule *Schedule = Schedules->GetSchedule(Channel)) {
+                 Schedule->Dump(f, "215-", DumpMode, AtTime);
+                 Ok = true;
+                 }
+              else
+                 Reply(550, "No schedule found");
+              }
            else
-              Schedules->Dump(f, "215-", DumpMode, AtTime);
+              Reply(451, "Can't get EPG data");
+           }
+        else if (cSchedules::Dump(f, "215-", DumpMode, AtTime)) // locks the schedules one at a time, so a slow client doesn't hold up incoming EPG data
+           Ok = true;
+        else
+           Reply(451, "Can't get EPG data");
+        if (Ok) {
            fflush(f);
            Reply(215, "End of EPG data");
-           fclose(f);
-           }
-        else {
-           Reply(451, "Can't open file connection");
-           close(fd);
            }
+        fclose(f);
+        }
+     else {
+        Reply(451, "Can't open file connection");
+        close(fd);
         }
-     else
-        Reply(451, "Can't dup stream descriptor");
      }
   else
-     Reply(451, "Can't get EPG data");
+     Reply(451, "Can't dup stream descriptor");
 }
 
 void cSVDRP::CmdLSTR(const char *Option)
@@ -1596,6 +1616,144 @@ void cSVDRP::CmdSCAN(const char *Option)
   Reply(250, "EPG scan triggered");
 }
 
+static int CompareEventsBySchedule(const void *a, const void *b)
+{
+  const cEvent *ea = *(const cEvent **)a;
+  const cEvent *eb = *(const cEvent **)b;
+  if (ea->Schedule() != eb->Schedule())
+     return ea->Schedule() < eb->Schedule() ? -1 : 1;
+  if (ea->StartTime() != eb->StartTime())
+     return ea->StartTime() < eb->StartTime() ? -1 : 1;
+  return 0;
+}
+
+void cSVDRP::CmdSRCH(const char *Option)
+{
+  cVector<cChannel *> QueryChannels;
+  time_t From = 0;
+  time_t To = 0;
+  int MaxEvents = 0;
+  // Options come first, all the rest is the actual query:
+  const char *s = skipspace(Option);
+  while (*s) {
+        const char *p = s;
+        while (*p && !isspace(*p))
+              p++;
+        cString Keyword(s, p);
+        const char *a = skipspace(p);
+        const char *e = a;
+        while (*e && !isspace(*e))
+              e++;
+        cString Arg(a, e);
+        if (strcasecmp(Keyword, "CHANNEL") == 0 || strcasecmp(Keyword, "FROM") == 0 || strcasecmp(Keyword, "TO") == 0 || strcasecmp(Keyword, "MAX") == 0) {
+           if (!*Arg) {
+              Reply(501, "Missing argument for \"%s\"", *Keyword);
+              return;
+              }
+           if (strcasecmp(Keyword, "CHANNEL") == 0) {
+              char buf[strlen(Arg) + 1];
+              strcpy(buf, Arg);
+              char *strtok_next;
+              for (char *c = strtok_r(buf, ",", &strtok_next); c; c = strtok_r(NULL, ",", &strtok_next)) {
+                  cChannel *Channel = isnumber(c) ? Channels.GetByNumber(strtol(c, NULL, 10)) : Channels.GetByChannelID(tChannelID::FromString(c));
+                  if (!Channel) {
+                     Reply(550, "Channel \"%s\" not defined", c);
+                     return;
+                     }
+                  QueryChannels.Append(Channel);
+                  }
+              }
+           else if (!isnumber(Arg)) {
+              Reply(501, "Invalid number: \"%s\"", *Arg);
+              return;
+              }
+           else if (strcasecmp(Keyword, "FROM") == 0)
+              From = strtol(Arg, NULL, 10);
+           else if (strcasecmp(Keyword, "TO") == 0)
+              To = strtol(Arg, NULL, 10);
+           else
+              MaxEvents = strtol(Arg, NULL, 10);
+           s = skipspace(e);
+           }
+        else
+           break;
+        }
+  if (!*s) {
+     Reply(501, "Missing search words");
+     return;
+     }
+  cEpgQuery Query(s);
+  for (int i = 0; i < QueryChannels.Size(); i++)
+      Query.AddChannel(QueryChannels[i]->GetChannelID());
+  Query.SetTime(From, To);
+  // The result is formatted while the schedules are locked, but only written
+  // after the lock has been released, so a slow client doesn't hold up incoming
+  // EPG data:
+  char *Buffer = NULL;
+  size_t Size = 0;
+  {
+    cSchedulesLock SchedulesLock;
+    const cSchedules *Schedules = cSchedules::Schedules(SchedulesLock);
+    if (!Schedules) {
+       Reply(451, "Can't get EPG data");
+       return;
+       }
+    cVector<const cEvent *> Events;
+    Schedules->Search(Query, Events, MaxEvents);
+    // The events come sorted by start time across all channels, so they are
+    // grouped by schedule here to produce the same format as LSTE:
+    Events.Sort(CompareEventsBySchedule);
+    cVector<int> Groups; // the index of the first event of every schedule in Events
+    for (int i = 0; i < Events.Size(); i++) {
+        if (i == 0 || Events[i]->Schedule() != Events[i - 1]->Schedule())
+           Groups.Append(i);
+        }
+    if (FILE *f = open_memstream(&Buffer, &Size)) {
+       // The groups are written in the order of the schedules:
+       for (const cSchedule *Schedule = Schedules->First(); Schedule && Groups.Size(); Schedule = Schedules->Next(Schedule)) {
+           int Lo = 0;
+           int Hi = Groups.Size();
+           while (Lo < Hi) {
+                 int Mid = (Lo + Hi) / 2;
+                 if (Events[Groups[Mid]]->Schedule() < Schedule)
+                    Lo = Mid + 1;
+                 else
+                    Hi = Mid;
+                 }
+           if (Lo < Groups.Size() && Events[Groups[Lo]]->Schedule() == Schedule) {
+              cChannel *Channel = Channels.GetByChannelID(Schedule->ChannelID(), true);
+              fprintf(f, "215-C %s %s\n", *Schedule->ChannelID().ToString(), Channel ? Channel->Name() : "");
+              for (int i = Groups[Lo]; i < Events.Size() && Events[i]->Schedule() == Schedule; i++)
+                  Events[i]->Dump(f, "215-");
+              fprintf(f, "215-c\n");
+              }
+           }
+       fclose(f);
+       }
+  }
+  if (!Buffer) {
+     Reply(451, "Can't allocate buffer");
+     return;
+     }
+  int fd = dup(file);
+  if (fd) {
+     FILE *f = fdopen(fd, "w");
+     if (f) {
+        fwrite(Buffer, Size, 1, f);
+        fflush(f);
+        Reply(215, "End of EPG data");
+        fclose(f);
+        }
+     else {
+        Reply(451, "Can't open file connection");
+        close(fd);
+        }
+     }
+  else
+     Reply(451, "Can't dup stream descriptor");
+  free(Buffer);
+}
+
 void cSVDRP::CmdSTAT(const char *Option)
 {
   if (*Option) {
@@ -1604,6 +1762,21 @@ void cSVDRP::CmdSTAT(const char *Option)
         int Percent = cVideoDirectory::VideoDiskSpace(&FreeMB, &UsedMB);
         Reply(250, "%dMB %dMB %d%%", FreeMB + UsedMB, FreeMB, Percent);
         }
+     else if (strcasecmp(Option, "BUFFERS") == 0) {
+        cStringList Statistics;
+        cRingBuffer::GetStatistics(Statistics);
+        if (Statistics.Size()) {
+           for (int i = 0; i < Statistics.Size(); i++)
+               Reply(i < Statistics.Size() - 1 ? -250 : 250, "%s", Statistics[i]);
+           }
+        else
+           Reply(550, "No ring buffers in use");
+        }
+     else if (strcasecmp(Option, "EIT") == 0) {
+        int Processed, Skipped, Dropped;
+        cEitFilter::GetStatistics(Processed, Skipped, Dropped);
+        Reply(250, "%d %d %d", Processed, Skipped, Dropped);
+        }
      else
         Reply(501, "Invalid Option \"%s\"", Option);
      }
@@ -1719,6 +1892,7 @@ void cSVDRP::Execute(char *Cmd)
   else if (CMD("PUTE"))  CmdPUTE(s);
   else if (CMD("REMO"))  CmdREMO(s);
   else if (CMD("SCAN"))  CmdSCAN(s);
+  else if (CMD("SRCH"))  CmdSRCH(s);
   else if (CMD("STAT"))  CmdSTAT(s);
   else if (CMD("UPDR"))  CmdUPDR(s);
   else if (CMD("UPDT"))  CmdUPDT(s);
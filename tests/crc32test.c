@@ -0,0 +1,121 @@
+/*
+ * crc32test.c: Test and benchmark for SI::CRC32
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Compares the CRCs computed by SI::CRC32::crc32() (which processes eight bytes
+ * at a time) with those of a plain bytewise implementation, for all lengths
+ * up to 64 bytes at every alignment, and checks the CRC-32/MPEG-2 check value.
+ * With -b the throughput of both implementations is measured.
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include "libsi/util.h"
+#include "tools.h"
+
+#define CHECKVALUE 0x0376E6E7 // CRC-32/MPEG-2 of "123456789"
+#define MAXLENGTH  64
+#define ALIGNMENTS 8
+
+class cBytewiseCrc32 : public SI::CRC32 {
+public:
+  static u_int32_t crc32(const char *d, int len, u_int32_t crc);
+  };
+
+u_int32_t cBytewiseCrc32::crc32(const char *d, int len, u_int32_t crc)
+{
+  const uchar *u = (const uchar *)d;
+  while (len-- > 0)
+        crc = (crc << 8) ^ crc_table[(crc >> 24) ^ *u++];
+  return crc;
+}
+
+static bool Test(void)
+{
+  bool Ok = true;
+  u_int32_t Crc = SI::CRC32::crc32("123456789", 9, 0xFFFFFFFF);
+  if (Crc != CHECKVALUE) {
+     fprintf(stderr, "check value is %08X, expected %08X\n", Crc, CHECKVALUE);
+     Ok = false;
+     }
+  char Buffer[MAXLENGTH + ALIGNMENTS];
+  srandom(1);
+  for (int i = 0; i < int(sizeof(Buffer)); i++)
+      Buffer[i] = random();
+  const u_int32_t Values[] = { 0xFFFFFFFF, 0x00000000, 0x12345678 };
+  for (int v = 0; v < int(sizeof(Values) / sizeof(Values[0])); v++) {
+      for (int a = 0; a < ALIGNMENTS; a++) {
+          for (int l = 0; l <= MAXLENGTH; l++) {
+              u_int32_t Sliced = SI::CRC32::crc32(Buffer + a, l, Values[v]);
+              u_int32_t Bytewise = cBytewiseCrc32::crc32(Buffer + a, l, Values[v]);
+              if (Sliced != Bytewise) {
+                 fprintf(stderr, "length %d at offset %d with initial value %08X: CRC is %08X, expected %08X\n", l, a, Values[v], Sliced, Bytewise);
+                 Ok = false;
+                 }
+              }
+          }
+      }
+  // Make sure every table entry is used (block i of the pattern uses entry i of
+  // all eight tables, so its first four bytes depend on the CRC so far):
+  uchar Pattern[256 * 8];
+  u_int32_t PatternCrc = 0xFFFFFFFF;
+  for (int i = 0; i < 256; i++) {
+      uchar *p = Pattern + i * 8;
+      for (int k = 0; k < 8; k++)
+          p[k] = k < 4 ? (PatternCrc >> (24 - 8 * k)) ^ i : i;
+      PatternCrc = cBytewiseCrc32::crc32((char *)p, 8, PatternCrc);
+      }
+  if (SI::CRC32::crc32((char *)Pattern, sizeof(Pattern), 0xFFFFFFFF) != PatternCrc) {
+     fprintf(stderr, "CRC of %d bytes differs from the bytewise one\n", int(sizeof(Pattern)));
+     Ok = false;
+     }
+  // A section including its CRC must yield 0:
+  u_int32_t SectionCrc = SI::CRC32::crc32(Buffer, MAXLENGTH - 4, 0xFFFFFFFF);
+  for (int i = 0; i < 4; i++)
+      Buffer[MAXLENGTH - 4 + i] = SectionCrc >> (24 - 8 * i);
+  if (!SI::CRC32::isValid(Buffer, MAXLENGTH)) {
+     fprintf(stderr, "section with CRC is not valid\n");
+     Ok = false;
+     }
+  return Ok;
+}
+
+static void Benchmark(int SectionSize, int TotalMB)
+{
+  char *Buffer = MALLOC(char, SectionSize);
+  for (int i = 0; i < SectionSize; i++)
+      Buffer[i] = random();
+  int Sections = int(MEGABYTE(TotalMB) / SectionSize);
+  for (int b = 0; b < 2; b++) {
+      u_int32_t Sum = 0;
+      cTimeMs Timer;
+      for (int i = 0; i < Sections; i++)
+          Sum += b ? cBytewiseCrc32::crc32(Buffer, SectionSize, 0xFFFFFFFF) : SI::CRC32::crc32(Buffer, SectionSize, 0xFFFFFFFF);
+      double Seconds = max(Timer.Elapsed(), uint64_t(1)) / 1000.0;
+      printf("%s: %d MB in sections of %d bytes in %.2f s (%.0f MB/s, %08X)\n", b ? "bytewise" : "sliced  ", TotalMB, SectionSize, Seconds, TotalMB / Seconds, Sum);
+      }
+  free(Buffer);
+}
+
+int main(int argc, char *argv[])
+{
+  int SectionSize = 4096; // the maximum size of an EIT section
+  int TotalMB = 0;
+  int c;
+  while ((c = getopt(argc, argv, "b:s:")) != -1) {
+        switch (c) {
+          case 'b': TotalMB = atoi(optarg); break;
+          case 's': SectionSize = max(atoi(optarg), 1); break;
+          default:
+               fprintf(stderr, "usage: crc32test [-b total size (MB) to run the benchmark] [-s section size]\n");
+               return 2;
+          }
+        }
+  bool Ok = Test();
+  printf("%s\n", Ok ? "OK" : "FAILED");
+  if (Ok && TotalMB > 0)
+     Benchmark(SectionSize, TotalMB);
+  return Ok ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+/*
+ * epgbatchbench.c: Benchmark for importing EPG data with cEpgBatch
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Generates EPG data in the format of the epg.data file and imports it,
+ * either through cEpgBatch (the way PUTE does) or through cSchedules::Read().
+ * Meanwhile a separate thread keeps taking read locks on the schedules, to
+ * see how long readers (like the OSD) are blocked by the import. Finally the
+ * events are updated with partial data (only the VPS times), and the existing
+ * fields are checked to be still intact.
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include "epg.h"
+#include "sources.h"
+#include "thread.h"
+#include "tools.h"
+
+#define TITLE       "Title of event %d"
+#define SHORTTEXT   "Short text of event %d"
+#define DESCRIPTION "Description of event %d, which is a little longer than the other texts,|since it takes several lines."
+#define COMPONENT   "1 03 deu 16:9"
+#define DURATION    1800
+#define VPSOFFSET   60
+
+class cLockWaiter : public cThread {
+private:
+  int maxWaitMs;
+  int locks;
+protected:
+  virtual void Action(void);
+public:
+  cLockWaiter(void) : cThread("lock waiter") { maxWaitMs = locks = 0; }
+  ~cLockWaiter() { Cancel(3); }
+  int MaxWaitMs(void) const { return maxWaitMs; }
+  int Locks(void) const { return locks; }
+  };
+
+void cLockWaiter::Action(void)
+{
+  while (Running()) {
+        cTimeMs Timer;
+        {
+          cSchedulesLock SchedulesLock;
+          if (cSchedules::Schedules(SchedulesLock))
+             locks++;
+        }
+        maxWaitMs = max(maxWaitMs, int(Timer.Elapsed()));
+        cCondWait::SleepMs(1);
+        }
+}
+
+static tChannelID ChannelID(int Channel)
+{
+  return tChannelID(cSource::FromString("S19.2E"), 1, 1000, Channel + 1);
+}
+
+static FILE *Generate(int NumEvents, int NumChannels, time_t Start, bool Partial)
+{
+  FILE *f = tmpfile();
+  if (!f)
+     return NULL;
+  int PerChannel = (NumEvents + NumChannels - 1) / NumChannels;
+  for (int c = 0, n = 0; c < NumChannels && n < NumEvents; c++) {
+      fprintf(f, "C %s Channel %d\n", *ChannelID(c).ToString(), c + 1);
+      for (int i = 0; i < PerChannel && n < NumEvents; i++, n++) {
+          time_t StartTime = Start + i * DURATION;
+          fprintf(f, "E %d %ld %d 4E\n", i + 1, StartTime, DURATION);
+          if (!Partial) {
+             fprintf(f, "T " TITLE "\n", n);
+             fprintf(f, "S " SHORTTEXT "\n", n);
+             fprintf(f, "D " DESCRIPTION "\n", n);
+             fprintf(f, "G 10 15\n");
+             fprintf(f, "R 12\n");
+             fprintf(f, "X " COMPONENT "\n");
+             }
+          fprintf(f, "V %ld\n", StartTime + (Partial ? VPSOFFSET : 0));
+          fprintf(f, "e\n");
+          }
+      fprintf(f, "c\n");
+      }
+  rewind(f);
+  return f;
+}
+
+static bool Import(FILE *f, bool Batch, const char *What)
+{
+  cLockWaiter LockWaiter;
+  LockWaiter.Start();
+  cCondWait::SleepMs(10);
+  cTimeMs Timer;
+  bool Ok;
+  if (Batch) {
+     cEpgBatch EpgBatch;
+     Ok = EpgBatch.Read(f);
+     int ReadMs = Timer.Elapsed();
+     Ok = Ok && EpgBatch.Import();
+     printf("%s: read in %d ms, imported in %d ms", What, ReadMs, int(Timer.Elapsed()) - ReadMs);
+     }
+  else {
+     Ok = cSchedules::Read(f);
+     printf("%s: read and imported in %d ms", What, int(Timer.Elapsed()));
+     }
+  cCondWait::SleepMs(10);
+  printf(", readers waited up to %d ms (%d read locks)\n", LockWaiter.MaxWaitMs(), LockWaiter.Locks());
+  return Ok;
+}
+
+static bool Verify(int NumEvents, int NumChannels, time_t Start)
+{
+  cSchedulesLock SchedulesLock;
+  const cSchedules *Schedules = cSchedules::Schedules(SchedulesLock);
+  if (!Schedules)
+     return false;
+  int PerChannel = (NumEvents + NumChannels - 1) / NumChannels;
+  int Found = 0;
+  for (int c = 0, n = 0; c < NumChannels && n < NumEvents; c++) {
+      const cSchedule *Schedule = Schedules->GetSchedule(ChannelID(c));
+      for (int i = 0; i < PerChannel && n < NumEvents; i++, n++) {
+          time_t StartTime = Start + i * DURATION;
+          const cEvent *Event = Schedule ? Schedule->GetEvent(i + 1, StartTime) : NULL;
+          if (!Event) {
+             fprintf(stderr, "event %d of channel %d is missing\n", i + 1, c + 1);
+             return false;
+             }
+          if (strcmp(Event->Title(), cString::sprintf(TITLE, n)) != 0
+           || strcmp(Event->ShortText(), cString::sprintf(SHORTTEXT, n)) != 0
+           || !Event->Description() || strncmp(Event->Description(), "Description", 11) != 0
+           || Event->Contents(0) != 0x10 || Event->Contents(1) != 0x15
+           || Event->ParentalRating() != 12
+           || Event->Vps() != StartTime + VPSOFFSET) {
+             fprintf(stderr, "event %d of channel %d has wrong data after a partial update\n", i + 1, c + 1);
+             return false;
+             }
+          Found++;
+          }
+      }
+  return Found == NumEvents;
+}
+
+int main(int argc, char *argv[])
+{
+  int NumEvents = 1000000;
+  int NumChannels = 200;
+  bool Batch = true;
+  int c;
+  while ((c = getopt(argc, argv, "c:n:o")) != -1) {
+        switch (c) {
+          case 'c': NumChannels = max(atoi(optarg), 1); break;
+          case 'n': NumEvents = atoi(optarg); break;
+          case 'o': Batch = false; break;
+          default:
+               fprintf(stderr, "usage: epgbatchbench [-n events] [-c channels] [-o (use cSchedules::Read())]\n");
+               return 2;
+          }
+        }
+  time_t Start = time(NULL) / 3600 * 3600 + 3600;
+  FILE *f = Generate(NumEvents, NumChannels, Start, false);
+  if (!f)
+     return 1;
+  fseek(f, 0, SEEK_END);
+  printf("%d events for %d channels (%d MB of EPG data)\n", NumEvents, NumChannels, int(ftell(f) / MEGABYTE(1)));
+  rewind(f);
+  bool Ok = Import(f, Batch, "full data");
+  fclose(f);
+  if (Ok && (f = Generate(NumEvents, NumChannels, Start, true)) != NULL) {
+     Ok = Import(f, true, "partial data");
+     fclose(f);
+     Ok = Ok && Verify(NumEvents, NumChannels, Start);
+     }
+  printf("%s\n", Ok ? "OK" : "FAILED");
+  return Ok ? 0 : 1;
+}
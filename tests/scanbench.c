@@ -0,0 +1,120 @@
+/*
+ * scanbench.c: Benchmark for scanning the video directory
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Generates a video directory with the given number of (tiny) recordings in
+ * a tree of series and episodes, and measures how long cRecordings takes to
+ * scan it, with and without the recordings catalog. Optionally every access
+ * to the file system is delayed, to emulate a slow (network) disk.
+ */
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "recording.h"
+#include "remux.h"
+#include "tools.h"
+#include "videodir.h"
+
+#define RECORDINGSPERFOLDER 10
+#define FOLDERSPERSERIES    10
+#define INDEXSIZE           (900 * 8) // 900 frames
+
+static int Latency = 0; // us
+
+// Emulates a slow file system by delaying every access to it by Latency:
+
+#define INTERPOSE(Result, Name, Params, Args) \
+extern "C" Result Name Params \
+{ \
+  static Result (*Real)Params = NULL; \
+  if (!Real) \
+     Real = (Result (*)Params)dlsym(RTLD_NEXT, #Name); \
+  if (Latency > 0) \
+     usleep(Latency); \
+  return Real Args; \
+}
+
+INTERPOSE(int, stat64, (const char *Path, struct stat64 *Buf) __THROW, (Path, Buf))
+INTERPOSE(int, lstat64, (const char *Path, struct stat64 *Buf) __THROW, (Path, Buf))
+INTERPOSE(int, access, (const char *Path, int Mode) __THROW, (Path, Mode))
+INTERPOSE(DIR *, opendir, (const char *Path), (Path))
+INTERPOSE(FILE *, fopen64, (const char *Path, const char *Mode), (Path, Mode))
+
+static bool WriteFile(const char *FileName, const char *Data, int Size)
+{
+  FILE *f = fopen(FileName, "w");
+  if (!f)
+     return false;
+  bool Result = fwrite(Data, Size, 1, f) == 1;
+  return fclose(f) == 0 && Result;
+}
+
+static bool Generate(const char *VideoDir, int NumRecordings)
+{
+  char *Index = MALLOC(char, INDEXSIZE);
+  memset(Index, 0, INDEXSIZE);
+  bool Result = true;
+  for (int i = 0; i < NumRecordings && Result; i++) {
+      cString Dir = cString::sprintf("%s/Series%03d/Episode%02d/2014-%02d-%02d.20.%02d.1-0.rec", VideoDir, i / (RECORDINGSPERFOLDER * FOLDERSPERSERIES), (i / RECORDINGSPERFOLDER) % FOLDERSPERSERIES, 1 + i % 12, 1 + i % 28, i % 60);
+      cString Info = cString::sprintf("C S19.2E-1-1089-12003 Das Erste\nE %d 1400000000 3600 4E 1\nT Title %d\nS Short text %d\nD Description of episode %d.\nF 25\nP 50\nL 99\n", i, i, i, i);
+      Result = MakeDirs(Dir, true)
+            && WriteFile(AddDirectory(Dir, "info"), Info, strlen(Info))
+            && WriteFile(AddDirectory(Dir, "index"), Index, INDEXSIZE)
+            && WriteFile(AddDirectory(Dir, "00001.ts"), Index, TS_SIZE * 10);
+      }
+  free(Index);
+  return Result;
+}
+
+static int Scan(const char *CatalogFileName, const char *What)
+{
+  cRecordings Recordings;
+  if (CatalogFileName)
+     Recordings.SetCatalogFileName(CatalogFileName);
+  cTimeMs Timer;
+  Recordings.Update(true);
+  printf("%s: %d recordings in %d ms\n", What, Recordings.Count(), int(Timer.Elapsed()));
+  return Recordings.Count();
+}
+
+int main(int argc, char *argv[])
+{
+  int NumRecordings = 10000;
+  int ScanLatency = 0;
+  int c;
+  while ((c = getopt(argc, argv, "l:n:")) != -1) {
+        switch (c) {
+          case 'l': ScanLatency = atoi(optarg); break;
+          case 'n': NumRecordings = atoi(optarg); break;
+          default: return 2;
+          }
+        }
+  if (optind != argc - 1) {
+     fprintf(stderr, "usage: scanbench [-n number of recordings] [-l latency of file system accesses (us)] directory\n");
+     return 2;
+     }
+  cString VideoDir = AddDirectory(argv[optind], "scanbench.video");
+  cString CatalogFileName = AddDirectory(argv[optind], "scanbench.bin");
+  SystemExec(cString::sprintf("rm -rf \"%s\" \"%s\"", *VideoDir, *CatalogFileName));
+  cTimeMs Timer;
+  if (!Generate(VideoDir, NumRecordings)) {
+     fprintf(stderr, "can't generate %s\n", *VideoDir);
+     return 1;
+     }
+  printf("generated %d recordings in %d ms\n", NumRecordings, int(Timer.Elapsed()));
+  cVideoDirectory::SetName(VideoDir);
+  Latency = ScanLatency;
+  bool Ok = Scan(NULL, "full scan") == NumRecordings
+         && Scan(CatalogFileName, "full scan, writing the catalog") == NumRecordings
+         && Scan(CatalogFileName, "scan with catalog") == NumRecordings;
+  Latency = 0;
+  printf("%s\n", Ok ? "OK" : "FAILED");
+  SystemExec(cString::sprintf("rm -rf \"%s\" \"%s\"", *VideoDir, *CatalogFileName));
+  return Ok ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+/*
+ * writertest.c: Test for cRecordingWriter
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Writes a recording with cRecordingWriter, the way cRecorder does, into the
+ * given directory (which may be on a tmpfs) and verifies the video and index
+ * files. Optionally the disk is throttled to the given rate, and the data
+ * stream stalls in the middle to check that pending data is written anyway.
+ */
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "recording.h"
+#include "remux.h"
+#include "tools.h"
+#include "videodir.h"
+
+#define PACKETSPERFRAME  50 // TS packets per frame
+#define FRAMESPERGOP     12
+#define STALLTIME        (3 * 100) // ms the data stream stalls (several times WRITERMAXDELAY)
+
+static int ThrottleRate = 0; // MB/s
+
+// Emulates a slow disk by delaying every large write() according to ThrottleRate:
+
+extern "C" ssize_t write(int fd, const void *Data, size_t Size)
+{
+  static ssize_t (*RealWrite)(int, const void *, size_t) = NULL;
+  if (!RealWrite)
+     RealWrite = (ssize_t (*)(int, const void *, size_t))dlsym(RTLD_NEXT, "write");
+  if (ThrottleRate > 0 && Size >= KILOBYTE(64))
+     usleep(useconds_t(Size * 1000000LL / MEGABYTE(ThrottleRate)));
+  return RealWrite(fd, Data, Size);
+}
+
+static void MakePacket(uchar *p, uint32_t Number)
+{
+  memset(p, 0xFF, TS_SIZE);
+  p[0] = TS_SYNC_BYTE;
+  p[1] = 0x01;
+  p[2] = 0x00;
+  p[3] = 0x10;
+  memcpy(p + 4, &Number, sizeof(Number));
+}
+
+static uint32_t PacketNumber(const uchar *p)
+{
+  uint32_t Number;
+  memcpy(&Number, p + 4, sizeof(Number));
+  return Number;
+}
+
+static off_t DiskSize(const char *Directory, int NumFiles)
+{
+  off_t Size = 0;
+  for (int i = 1; i <= NumFiles; i++)
+      Size += max(FileSize(cString::sprintf("%s/%05d.ts", Directory, i)), off_t(0));
+  return Size;
+}
+
+static bool Verify(const char *Directory, int NumFrames, uint32_t NumPackets)
+{
+  // Video files:
+  uint32_t Expected = 0;
+  for (int i = 1; ; i++) {
+      cString FileName = cString::sprintf("%s/%05d.ts", Directory, i);
+      FILE *f = fopen(FileName, "r");
+      if (!f)
+         break;
+      uchar p[TS_SIZE];
+      while (fread(p, TS_SIZE, 1, f) == 1) {
+            if (PacketNumber(p) != Expected) {
+               fprintf(stderr, "%s: packet %u found where %u was expected\n", *FileName, PacketNumber(p), Expected);
+               fclose(f);
+               return false;
+               }
+            Expected++;
+            }
+      fclose(f);
+      }
+  if (Expected != NumPackets) {
+     fprintf(stderr, "%u packets found, %u expected\n", Expected, NumPackets);
+     return false;
+     }
+  // Index:
+  cIndexFile Index(Directory, false);
+  cFileName FileName(Directory, false);
+  if (Index.Last() != NumFrames - 1) {
+     fprintf(stderr, "%d index entries found, %d expected\n", Index.Last() + 1, NumFrames);
+     return false;
+     }
+  for (int i = 0; i < NumFrames; i++) {
+      uint16_t FileNumber;
+      off_t FileOffset;
+      bool Independent;
+      uchar p[TS_SIZE];
+      if (!Index.Get(i, &FileNumber, &FileOffset, &Independent)) {
+         fprintf(stderr, "can't get index entry %d\n", i);
+         return false;
+         }
+      cUnbufferedFile *File = FileName.SetOffset(FileNumber, FileOffset);
+      if (!File || File->Read(p, TS_SIZE) != TS_SIZE || PacketNumber(p) != uint32_t(i * PACKETSPERFRAME) || Independent != (i % FRAMESPERGOP == 0)) {
+         fprintf(stderr, "index entry %d doesn't point to the right frame\n", i);
+         return false;
+         }
+      }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int TotalMB = 256;
+  int MaxFileMB = 64;
+  int c;
+  while ((c = getopt(argc, argv, "f:s:t:")) != -1) {
+        switch (c) {
+          case 'f': MaxFileMB = atoi(optarg); break;
+          case 's': TotalMB = atoi(optarg); break;
+          case 't': ThrottleRate = atoi(optarg); break;
+          default: return 2;
+          }
+        }
+  if (optind != argc - 1) {
+     fprintf(stderr, "usage: writertest [-s total size (MB)] [-f max. file size (MB)] [-t throttle rate (MB/s)] directory\n");
+     return 2;
+     }
+  cString Directory = AddDirectory(argv[optind], "writertest.rec");
+  cVideoDirectory::SetName(argv[optind]);
+  SystemExec(cString::sprintf("rm -rf \"%s\"", *Directory));
+  if (!MakeDirs(Directory, true))
+     return 1;
+  bool Ok = true;
+  int NumFrames = 0;
+  uint32_t NumPackets = 0;
+  int NumFiles = 1;
+  int MaxWriteMs = 0;
+  cTimeMs Timer;
+  {
+    cFileName FileName(Directory, true);
+    cIndexFile Index(Directory, true);
+    if (!FileName.Open())
+       return 1;
+    cRecordingWriter Writer(&FileName, &Index);
+    uchar Frame[PACKETSPERFRAME * TS_SIZE];
+    int Frames = int(MEGABYTE(TotalMB) / sizeof(Frame));
+    for (int i = 0; i < Frames && Ok; i++) {
+        while (!Writer.WaitForSpace(100))
+              ;
+        bool Independent = i % FRAMESPERGOP == 0;
+        for (int p = 0; p < PACKETSPERFRAME; p++)
+            MakePacket(Frame + p * TS_SIZE, NumPackets++);
+        cTimeMs WriteTimer;
+        if (Independent && Writer.FileSize() > MEGABYTE(MaxFileMB)) {
+           Writer.NextFile();
+           NumFiles++;
+           }
+        Writer.WriteIndex(Independent);
+        Writer.Write(Frame, sizeof(Frame));
+        MaxWriteMs = max(MaxWriteMs, int(WriteTimer.Elapsed()));
+        NumFrames++;
+        if (i == Frames / 2) {
+           // Let the data stream stall, and make sure everything gets written meanwhile:
+           cCondWait::SleepMs(STALLTIME + MEGABYTE(16) * 1000LL / MEGABYTE(max(ThrottleRate, 16)));
+           off_t Expected = off_t(NumPackets) * TS_SIZE;
+           off_t Written = DiskSize(Directory, NumFiles);
+           if (Written != Expected) {
+              fprintf(stderr, "stalled stream: %lld of %lld bytes written\n", (long long)Written, (long long)Expected);
+              Ok = false;
+              }
+           else if (Index.Last() != NumFrames - 1) {
+              fprintf(stderr, "stalled stream: %d of %d index entries written\n", Index.Last() + 1, NumFrames);
+              Ok = false;
+              }
+           else
+              printf("stalled stream: all data written\n");
+           }
+        }
+    if (!Writer.Flush() || Writer.Error()) {
+       fprintf(stderr, "writer reported an error\n");
+       Ok = false;
+       }
+  }
+  double Seconds = Timer.Elapsed() / 1000.0;
+  printf("%d MB in %d files written in %.1f s (%.1f MB/s), longest Write() took %d ms\n", TotalMB, NumFiles, Seconds, TotalMB / Seconds, MaxWriteMs);
+  Ok = Ok && Verify(Directory, NumFrames, NumPackets);
+  printf("%s\n", Ok ? "OK" : "FAILED");
+  SystemExec(cString::sprintf("rm -rf \"%s\"", *Directory));
+  return Ok ? 0 : 1;
+}
@@ -551,7 +551,7 @@ void cTimer::SetEventFromSchedule(const cSchedules *Schedules)
            Matches(0, true);
            time_t TimeFrameBegin = StartTime() - EPGLIMITBEFORE;
            time_t TimeFrameEnd   = StopTime()  + EPGLIMITAFTER;
-           for (const cEvent *e = Schedule->Events()->First(); e; e = Schedule->Events()->Next(e)) {
+           for (const cEvent *e = Schedule->GetEventFrom(TimeFrameBegin); e; e = Schedule->Events()->Next(e)) {
                if (e->EndTime() < TimeFrameBegin)
                   continue; // skip events way before the timer starts
                if (e->StartTime() > TimeFrameEnd)
@@ -2174,6 +2174,16 @@ void cHashBase::Clear(void)
       }
 }
 
+void cHashBase::Swap(cHashBase &Hash)
+{
+  cList<cHashObject> **t = hashTable;
+  hashTable = Hash.hashTable;
+  Hash.hashTable = t;
+  int s = size;
+  size = Hash.size;
+  Hash.size = s;
+}
+
 cListObject *cHashBase::Get(unsigned int Id) const
 {
   cList<cHashObject> *list = hashTable[hashfn(Id)];
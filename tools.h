@@ -664,6 +664,8 @@ public:
   void Add(cListObject *Object, unsigned int Id);
   void Del(cListObject *Object, unsigned int Id);
   void Clear(void);
+  void Swap(cHashBase &Hash);
+       ///< Exchanges the contents of this hash with those of the given Hash.
   cListObject *Get(unsigned int Id) const;
   cList<cHashObject> *GetList(unsigned int Id) const;
   };
@@ -55,6 +55,29 @@ void cTransfer::Receive(uchar *Data, int Length)
      }
 }
 
+void cTransfer::ReceiveBlock(uchar *Data, int Length)
+{
+  if (cPlayer::IsAttached()) {
+     // Same as Receive(), but PlayTs() may only accept part of the block:
+     int Retries = 0;
+     while (Length > 0) {
+           int Played = PlayTs(Data, Length);
+           if (Played > 0) {
+              Data += Played;
+              Length -= Played;
+              Retries = 0;
+              }
+           else if (++Retries < MAXRETRIES)
+              cCondWait::SleepMs(RETRYWAIT);
+           else {
+              DeviceClear();
+              esyslog("ERROR: %d bytes of TS data not accepted in Transfer Mode", Length);
+              break;
+              }
+           }
+     }
+}
+
 // --- cTransferControl ------------------------------------------------------
 
 cDevice *cTransferControl::receiverDevice = NULL;
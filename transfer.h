@@ -20,6 +20,7 @@ private:
 protected:
   virtual void Activate(bool On);
   virtual void Receive(uchar *Data, int Length);
+  virtual void ReceiveBlock(uchar *Data, int Length);
 public:
   cTransfer(const cChannel *Channel);
   virtual ~cTransfer();
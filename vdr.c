@@ -738,6 +738,7 @@ int main(int argc, char *argv[])
   // Configuration data:
 
   Setup.Load(AddDirectory(ConfigDirectory, "setup.conf"));
+  cRingBuffer::SetHugePages(Setup.UseHugePages);
   Sources.Load(AddDirectory(ConfigDirectory, "sources.conf"), true, true);
   Diseqcs.Load(AddDirectory(ConfigDirectory, "diseqc.conf"), true, Setup.DiSEqC);
   Scrs.Load(AddDirectory(ConfigDirectory, "scr.conf"), true);
@@ -758,6 +759,7 @@ int main(int argc, char *argv[])
 
   // Recordings:
 
+  Recordings.SetCatalogFileName(AddDirectory(CacheDirectory, "recordings.bin"));
   Recordings.Update();
   DeletedRecordings.Update();
 